@@ -0,0 +1,116 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _QRT_BENCH_HPP_
+#define _QRT_BENCH_HPP_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+namespace bench {
+
+    // results are kept in memory and printed at the end, so that the output
+    // does not perturb the measures. One row per measure:
+    //
+    //   bench,variant,n,metric,value
+    //
+
+    struct row
+    {
+        std::string bench;
+        std::string variant;
+        uint64_t    n;
+        std::string metric;
+        double      value;
+    };
+
+    class report
+    {
+        std::vector<row> _M_rows;
+        bool             _M_json;
+
+    public:
+        report(int argc, char *argv[])
+        : _M_rows(), _M_json(false)
+        {
+            for(int i = 1; i < argc; ++i)
+                if (std::strcmp(argv[i], "--json") == 0)
+                    _M_json = true;
+        }
+
+        void
+        add(const std::string &bench, const std::string &variant, uint64_t n, const std::string &metric, double value)
+        {
+            row r = { bench, variant, n, metric, value };
+            _M_rows.push_back(r);
+        }
+
+        void
+        write(std::ostream &out) const
+        {
+            out.precision(10);
+
+            if (_M_json)
+            {
+                out << "[\n";
+                for(std::size_t i = 0; i < _M_rows.size(); ++i)
+                {
+                    const row &r = _M_rows[i];
+                    out << "  {\"bench\":\"" << r.bench << "\",\"variant\":\"" << r.variant << "\",\"n\":" << r.n
+                        << ",\"metric\":\"" << r.metric << "\",\"value\":" << r.value << "}" 
+                        << (i + 1 < _M_rows.size() ? ",\n" : "\n");
+                }
+                out << "]" << std::endl;
+            }
+            else
+            {
+                out << "bench,variant,n,metric,value\n";
+                for(const row &r : _M_rows)
+                    out << r.bench << ',' << r.variant << ',' << r.n << ',' << r.metric << ',' << r.value << '\n';
+                out.flush();
+            }
+        }
+    };
+
+    // positional argument, skipping the options...
+    //
+
+    inline const char *
+    arg(int argc, char *argv[], int pos)
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            if (argv[i][0] == '-')
+                continue;
+            if (pos-- == 0)
+                return argv[i];
+        }
+        return 0;
+    }
+
+} // namespace bench
+
+#endif /* _QRT_BENCH_HPP_ */
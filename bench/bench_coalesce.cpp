@@ -0,0 +1,127 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <qrt_thread.hpp>
+
+#include "bench.hpp"
+
+#include <vector>
+#include <cstdlib>
+
+// many-flow pacing: periodic threads with random phases, that tolerate an
+// early activation (qrt_coalesce), dispatched one by one or in batches for 
+// a growing coalescing window.
+//
+//   bench_coalesce [flows = 1000] [period us = 1000] [duration ms = 1000] [--json]
+//
+
+struct pacing_thread : public qrt::thread
+{
+    qrt::this_cpu::cycles_type _M_period;
+    qrt::this_cpu::cycles_type _M_slack;
+    qrt::this_cpu::cycles_type _M_ts;
+
+public:
+    pacing_thread(qrt::this_cpu::cycles_type b, qrt::this_cpu::cycles_type e, 
+                  qrt::this_cpu::cycles_type period, qrt::this_cpu::cycles_type slack)
+    : qrt::thread(b, e), _M_period(period), _M_slack(slack), _M_ts()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(_M_ts = this->begin(); _M_ts < this->end(); )
+        {
+            _M_ts += _M_period;
+            qrt_coalesce(_M_ts, _M_slack);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+void run(bench::report &rep, int nflow, uint64_t period_us, uint64_t duration_ms, uint64_t window_us)
+{
+    const qrt::tsc_clock &clock = qrt::tsc_clock::instance();
+
+    qrt::stat_deadline_scheduler sched;
+    std::vector<pacing_thread *> threads;
+
+    qrt::this_cpu::cycles_type period = clock.from_us(period_us);
+    qrt::this_cpu::cycles_type window = clock.from_us(window_us);
+    qrt::this_cpu::cycles_type now = qrt::this_cpu::get_cycles() + clock.from_ms(10);
+
+    sched.coalesce_window(window);
+
+    for(int i = 0; i < nflow; ++i)
+    {
+        qrt::this_cpu::cycles_type b = now + period * i / nflow;
+        threads.push_back(new pacing_thread(b, b + clock.from_ms(duration_ms), period, window));
+        sched(threads.back());
+    }
+
+    qrt::this_cpu::cycles_type t0 = qrt::this_cpu::get_cycles();
+    sched.start();
+    sched.join();
+    qrt::this_cpu::cycles_type t1 = qrt::this_cpu::get_cycles();
+
+    for(pacing_thread * t : threads)
+        delete t;
+
+    const qrt::stat_type<qrt::this_cpu> &s = sched.stat();
+    const qrt::histogram &h = s.lateness;
+    const std::string variant = "window_" + std::to_string(window_us) + "us";
+
+    rep.add("coalesce", variant, nflow, "dispatches", double(h.count()));
+    rep.add("coalesce", variant, nflow, "batches",    double(s.batch));
+    rep.add("coalesce", variant, nflow, "per_batch",  s.batch ? double(h.count()) / s.batch : 1.0);
+    rep.add("coalesce", variant, nflow, "misses",     double(s.miss));
+    rep.add("coalesce", variant, nflow, "p99_ns",     double(clock.to_ns(h.percentile(99))));
+    rep.add("coalesce", variant, nflow, "max_ns",     double(clock.to_ns(h.max())));
+    rep.add("coalesce", variant, nflow, "wall_ms",    double(clock.to_ns(t1 - t0)) / 1e6);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    bench::report rep(argc, argv);
+
+    const char * a0 = bench::arg(argc, argv, 0);
+    const char * a1 = bench::arg(argc, argv, 1);
+    const char * a2 = bench::arg(argc, argv, 2);
+
+    int      nflow    = a0 ? std::atoi(a0) : 1000;
+    uint64_t period   = a1 ? std::strtoull(a1, 0, 10) : 1000;
+    uint64_t duration = a2 ? std::strtoull(a2, 0, 10) : 1000;
+
+    const uint64_t window[] = { 0, 1, 5, 20 };
+
+    for(uint64_t w : window)
+        run(rep, nflow, period, duration, w);
+
+    rep.write(std::cout);
+    return 0;
+}
@@ -0,0 +1,150 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_heap.hpp>
+#include <qrt_utils.hpp>
+
+#include "bench.hpp"
+
+#include <memory>
+#include <random>
+#include <vector>
+#include <cstdlib>
+
+// push, pop and hold (pop the earliest deadline, push it back one period
+// later) cost of the heap policies, in cycles per operation:
+//
+//   bench_heap [max threads = 1000000] [--json]
+//
+
+typedef unsigned long long key_type;
+
+static const key_type period = 1000000;     // cycles
+
+struct node
+{
+    qrt::intrusive::pairing_hook<key_type, node *> hook;
+
+    qrt::intrusive::pairing_hook<key_type, node *> &
+    pairing()
+    { return hook; }
+};
+
+template <template <typename, typename> class Heap>
+struct bench_value           /* the scheduler stores pointers to threads */
+{
+    typedef int * type;
+
+    std::vector<int> _M_obj;
+
+    explicit bench_value(std::size_t n) : _M_obj(n) {}
+    type operator[](std::size_t i) { return &_M_obj[i]; }
+};
+
+template <>
+struct bench_value<qrt::intrusive::pairing_heap>
+{
+    typedef node * type;
+
+    std::vector<node> _M_obj;
+
+    explicit bench_value(std::size_t n) : _M_obj(n) {}
+    type operator[](std::size_t i) { return &_M_obj[i]; }
+};
+
+
+template <template <typename, typename> class Heap>
+void run(bench::report &rep, const char *name, std::size_t n)
+{
+    typedef bench_value<Heap> values_type;
+    typedef Heap<key_type, typename values_type::type> heap_type;
+
+    std::unique_ptr<heap_type> heap(new heap_type);
+    values_type values(n);
+
+    std::mt19937_64 rand(n);
+    std::vector<key_type> keys(n);
+    key_type now = 1ULL << 40;
+    for(std::size_t i = 0; i < n; ++i)
+        keys[i] = now + rand() % period;
+
+    const std::size_t hold = std::max<std::size_t>(n, 100000);
+    std::vector<key_type> incr(hold);
+    for(std::size_t i = 0; i < hold; ++i)
+        incr[i] = 1 + rand() % period;
+
+    // push...
+
+    qrt::tsc_clock::cycles_type t0 = qrt::tsc_clock::rdtsc_ordered();
+    for(std::size_t i = 0; i < n; ++i)
+        heap->push(keys[i], values[i]);
+    qrt::tsc_clock::cycles_type t1 = qrt::tsc_clock::rdtsc_ordered();
+
+    // hold...
+
+    for(std::size_t i = 0; i < hold; ++i)
+    {
+        typename heap_type::value_type e = heap->pop();
+        heap->push(e.first + incr[i], e.second);
+    }
+    qrt::tsc_clock::cycles_type t2 = qrt::tsc_clock::rdtsc_ordered();
+
+    // pop...
+
+    key_type sum = 0;
+    while (!heap->empty())
+        sum += heap->pop().first;
+    qrt::tsc_clock::cycles_type t3 = qrt::tsc_clock::rdtsc_ordered();
+
+    if (sum == 0)
+        std::cerr << name << ": empty heap?" << std::endl;
+
+    rep.add("heap", name, n, "push_cycles", double(t1 - t0) / n);
+    rep.add("heap", name, n, "hold_cycles", double(t2 - t1) / hold);
+    rep.add("heap", name, n, "pop_cycles",  double(t3 - t2) / n);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    bench::report rep(argc, argv);
+
+    const char * arg = bench::arg(argc, argv, 0);
+    std::size_t max = arg ? std::strtoul(arg, 0, 10) : 1000000;
+
+    for(std::size_t n = 1; n <= max; n *= 10)
+    {
+        run<qrt::random_access::vector_heap>(rep, "vector_heap", n);
+        run<qrt::random_access::deque_heap>(rep, "deque_heap", n);
+        run<qrt::random_access::priority_queue_heap>(rep, "priority_queue_heap", n);
+        run<qrt::random_access::static_capacity<1 << 20>::heap>(rep, "static_heap", n);
+        run<qrt::wheel::timing_wheel>(rep, "timing_wheel", n);
+        run<qrt::dary::heap>(rep, "dary::heap", n);
+        run<qrt::dary::compact_heap>(rep, "dary::compact_heap", n);
+        run<qrt::intrusive::pairing_heap>(rep, "intrusive::pairing_heap", n);
+    }
+
+    rep.write(std::cout);
+    return 0;
+}
@@ -0,0 +1,114 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_thread.hpp>
+
+#include "bench.hpp"
+
+#include <vector>
+#include <cstdlib>
+
+// dispatch lateness distribution (ns) of periodic threads: the threads share
+// the scheduler with the same period and random phases.
+//
+//   bench_lateness [period us = 100] [duration ms = 1000] [--json]
+//
+
+struct periodic_thread : public qrt::thread
+{
+    qrt::this_cpu::cycles_type _M_period;
+    qrt::this_cpu::cycles_type _M_ts;
+
+public:
+    periodic_thread(qrt::this_cpu::cycles_type b, qrt::this_cpu::cycles_type e, qrt::this_cpu::cycles_type period)
+    : qrt::thread(b, e), _M_period(period), _M_ts()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(_M_ts = this->begin(); _M_ts < this->end(); )
+        {
+            _M_ts += _M_period;
+            qrt_force_schedule(_M_ts);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+void run(bench::report &rep, int nthread, uint64_t period_us, uint64_t duration_ms)
+{
+    const qrt::tsc_clock &clock = qrt::tsc_clock::instance();
+
+    qrt::stat_deadline_scheduler sched;
+    std::vector<periodic_thread *> threads;
+
+    qrt::this_cpu::cycles_type period = clock.from_us(period_us);
+    qrt::this_cpu::cycles_type now = qrt::this_cpu::get_cycles() + clock.from_ms(10);
+
+    for(int i = 0; i < nthread; ++i)
+    {
+        qrt::this_cpu::cycles_type b = now + period * i / nthread;
+        threads.push_back(new periodic_thread(b, b + clock.from_ms(duration_ms), period));
+        sched(threads.back());
+    }
+
+    sched.start();
+    sched.join();
+
+    for(periodic_thread * t : threads)
+        delete t;
+
+    const qrt::histogram &h = sched.stat().lateness;
+
+    rep.add("lateness", "force_schedule", nthread, "dispatches", double(h.count()));
+    rep.add("lateness", "force_schedule", nthread, "misses", double(sched.stat().miss));
+    rep.add("lateness", "force_schedule", nthread, "p50_ns",    double(clock.to_ns(h.percentile(50))));
+    rep.add("lateness", "force_schedule", nthread, "p99_ns",    double(clock.to_ns(h.percentile(99))));
+    rep.add("lateness", "force_schedule", nthread, "p99.9_ns",  double(clock.to_ns(h.percentile(99.9))));
+    rep.add("lateness", "force_schedule", nthread, "p99.99_ns", double(clock.to_ns(h.percentile(99.99))));
+    rep.add("lateness", "force_schedule", nthread, "max_ns",    double(clock.to_ns(h.max())));
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    bench::report rep(argc, argv);
+
+    const char * a0 = bench::arg(argc, argv, 0);
+    const char * a1 = bench::arg(argc, argv, 1);
+
+    uint64_t period   = a0 ? std::strtoull(a0, 0, 10) : 100;
+    uint64_t duration = a1 ? std::strtoull(a1, 0, 10) : 1000;
+
+    for(int nthread = 1; nthread <= 256; nthread *= 4)
+        run(rep, nthread, period, duration);
+
+    rep.write(std::cout);
+    return 0;
+}
@@ -0,0 +1,156 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_thread.hpp>
+#ifdef __x86_64__
+#include <qrt_context.hpp>
+#endif
+
+#include "bench.hpp"
+
+#include <vector>
+#include <cstdlib>
+
+// round-trip cost of a context switch (thread -> scheduler -> next thread),
+// in cycles: every thread yields with an expired deadline, hence the 
+// scheduler dispatches the next one at once.
+//
+//   bench_switch [switches per thread = 10000] [--json]
+//
+
+struct context_switch_thread : public qrt::thread
+{
+    int _M_n, _M_i;
+
+public:
+    context_switch_thread(qrt::this_cpu::cycles_type b, int n)
+    : qrt::thread(b, ~0ULL), _M_n(n), _M_i()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(_M_i = 0; _M_i < _M_n; ++_M_i)
+        {
+            qrt_context_switch(qrt::this_cpu::get_cycles());
+        }
+
+        qrt_context_end;
+    }    
+};
+
+struct sleep_for_thread : public qrt::thread
+{
+    int _M_n, _M_i;
+
+public:
+    sleep_for_thread(qrt::this_cpu::cycles_type b, int n)
+    : qrt::thread(b, ~0ULL), _M_n(n), _M_i()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(_M_i = 0; _M_i < _M_n; ++_M_i)
+        {
+            qrt_sleep_for(0);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+#ifdef __x86_64__
+
+struct stackful_thread : public qrt::stackful_thread
+{
+    int _M_n;
+
+public:
+    stackful_thread(qrt::this_cpu::cycles_type b, int n)
+    : qrt::stackful_thread(b, ~0ULL), _M_n(n)
+    {}
+
+    void 
+    main()
+    {
+        for(int i = 0; i < _M_n; ++i)
+            this->context_switch(qrt::this_cpu::get_cycles());
+    }    
+};
+
+#endif
+
+template <typename Thread>
+void run(bench::report &rep, const char *name, int nthread, int nswitch)
+{
+    qrt::deadline_scheduler sched;
+    std::vector<Thread *> threads;
+
+    qrt::this_cpu::cycles_type now = qrt::this_cpu::get_cycles();
+    for(int i = 0; i < nthread; ++i)
+    {
+        threads.push_back(new Thread(now, nswitch));
+        sched(threads.back());
+    }
+
+    qrt::tsc_clock::cycles_type t0 = qrt::tsc_clock::rdtsc_ordered();
+    sched.start();
+    sched.join();
+    qrt::tsc_clock::cycles_type t1 = qrt::tsc_clock::rdtsc_ordered();
+
+    for(Thread * t : threads)
+        delete t;
+
+    const double n = double(nthread) * (nswitch + 1);
+    rep.add("switch", name, nthread, "cycles", double(t1 - t0) / n);
+    rep.add("switch", name, nthread, "ns", double(qrt::tsc_clock::instance().to_ns(t1 - t0)) / n);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    bench::report rep(argc, argv);
+
+    const char * arg = bench::arg(argc, argv, 0);
+    int nswitch = arg ? atoi(arg) : 10000;
+
+    qrt::tsc_clock::instance();
+
+    for(int nthread = 1; nthread <= 4096; nthread *= 16)
+    {
+        run<context_switch_thread>(rep, "qrt_context_switch", nthread, nswitch);
+        run<sleep_for_thread>(rep, "qrt_sleep_for", nthread, nswitch);
+#ifdef __x86_64__
+        run<stackful_thread>(rep, "stackful", nthread, nswitch);
+#endif
+    }
+
+    rep.write(std::cout);
+    return 0;
+}
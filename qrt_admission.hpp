@@ -0,0 +1,324 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _QRT_ADMISSION_HPP_
+#define _QRT_ADMISSION_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+
+namespace qrt {
+
+    ///////////////////// periodic (or sporadic) task model
+    //
+    // period:   (minimum) inter-arrival time of the activations
+    // deadline: relative deadline (0 = the period)
+    // wcet:     execution budget of an activation
+    //
+    // a thread without a model (period 0) is not subject to admission control.
+
+    template <typename T>
+    struct periodic_task
+    {
+        typename T::cycles_type  period;
+        typename T::cycles_type  deadline;
+        typename T::cycles_type  wcet;
+
+        periodic_task()
+        : period(0), deadline(0), wcet(0)
+        {}
+
+        periodic_task(typename T::cycles_type p, typename T::cycles_type c, typename T::cycles_type d = 0)
+        : period(p), deadline(d), wcet(c)
+        {}
+
+        typename T::cycles_type
+        relative_deadline() const
+        { return deadline ? deadline : period; }
+
+        double
+        utilization() const
+        { return period ? static_cast<double>(wcet) / static_cast<double>(period) : 0.0; }
+    };
+
+    ///////////////////// edf_admission
+    //
+    // EDF feasibility on a processor of capacity cap (0..1], i.e. on which the
+    // budgets take wcet/cap:
+    //
+    // - implicit or arbitrary deadlines (D >= P): U <= 1 (Liu & Layland)
+    // - constrained deadlines (D < P): processor demand criterion, h(t) <= t
+    //   for every absolute deadline t below the bound L_a (Baruah et al.),
+    //   checked by the Quick Processor-demand Analysis (F. Zhang, A. Burns, 
+    //   "Schedulability Analysis for Real-Time Systems with EDF Scheduling",
+    //   IEEE ToC 2009), which visits a handful of deadlines only.
+    //
+    // Not thread-safe: the scheduler serializes the accesses.
+
+    template <typename T, typename Key>
+    class edf_admission
+    {
+    public:
+        typedef periodic_task<T> task_type;
+
+    private:
+        std::vector<std::pair<Key, task_type> > _M_tasks;
+        double                                  _M_cap;
+        double                                  _M_util;
+
+        struct scaled
+        {
+            double p, d, c;
+        };
+
+        // the largest absolute deadline strictly below t (-1 if none)...
+
+        static double
+        _S_last_deadline(const std::vector<scaled> &ts, double t)
+        {
+            double r = -1;
+            for(const scaled &s : ts)
+            {
+                if (s.d >= t)
+                    continue;
+                double d = s.d + std::floor((t - s.d) / s.p) * s.p;
+                if (d >= t)
+                    d -= s.p;
+                r = std::max(r, d);
+            }
+            return r;
+        }
+
+        // processor demand in [0,t]...
+
+        static double
+        _S_demand(const std::vector<scaled> &ts, double t)
+        {
+            double h = 0;
+            for(const scaled &s : ts)
+                if (s.d <= t)
+                    h += (std::floor((t - s.d) / s.p) + 1) * s.c;
+            return h;
+        }
+
+        bool
+        _M_feasible(const task_type *extra) const
+        {
+            std::vector<scaled> ts;
+            ts.reserve(_M_tasks.size() + 1);
+
+            double u = 0, dmin = HUGE_VAL, dmax = 0, slack = 0;
+            bool constrained = false;
+
+            auto add = [&](const task_type &k) {
+                scaled s = { static_cast<double>(k.period), static_cast<double>(k.relative_deadline()), 
+                             static_cast<double>(k.wcet) / _M_cap };
+                u     += s.c / s.p;
+                dmin   = std::min(dmin, s.d);
+                dmax   = std::max(dmax, s.d);
+                slack += std::max(0.0, s.p - s.d) * s.c / s.p;
+                constrained |= s.d < s.p;
+                ts.push_back(s);
+            };
+
+            for(const auto &e : _M_tasks)
+                add(e.second);
+            if (extra)
+                add(*extra);
+
+            if (u > 1.0)
+                return false;
+            if (!constrained)
+                return true;
+            if (u >= 1.0 - 1e-9)    // L_a is unbounded: be conservative
+                return false;
+
+            // QPA...
+
+            const double la = std::max(dmax, slack / (1.0 - u));
+            double t = _S_last_deadline(ts, la + 1);
+            double h = _S_demand(ts, t);
+
+            while (h <= t && h > dmin)
+            {
+                if (h < t)
+                    t = h;
+                else
+                    t = _S_last_deadline(ts, t);
+                h = _S_demand(ts, t);
+            }
+
+            return h <= dmin;
+        }
+
+    public:
+        explicit edf_admission(double cap = 1.0)
+        : _M_tasks(), _M_cap(cap), _M_util(0)
+        {}
+
+        double
+        cap() const
+        { return _M_cap; }
+
+        void
+        cap(double value)
+        { _M_cap = value; }
+
+        // utilization of the admitted tasks...
+
+        double
+        utilization() const
+        { return _M_util; }
+
+        std::size_t
+        size() const
+        { return _M_tasks.size(); }
+
+        bool
+        admissible(const task_type &t) const
+        {
+            if (t.period == 0)
+                return true;
+            if (t.wcet > t.relative_deadline())
+                return false;
+            return _M_feasible(&t);
+        }
+
+        bool
+        admit(Key key, const task_type &t)
+        {
+            if (!admissible(t))
+                return false;
+            if (t.period) {
+                _M_tasks.push_back(std::make_pair(key, t));
+                _M_util += t.utilization();
+            }
+            return true;
+        }
+
+        void
+        release(Key key)
+        {
+            for(std::size_t i = 0; i < _M_tasks.size(); ++i)
+            {
+                if (_M_tasks[i].first == key) {
+                    _M_util -= _M_tasks[i].second.utilization();
+                    _M_tasks.erase(_M_tasks.begin() + i);
+                    return;
+                }
+            }
+        }
+    };
+
+    ///////////////////// response-time analysis (fixed priorities)
+    //
+    // worst-case response times of a set of periodic tasks under the priority::
+    // heap policy: tasks are given in priority order (the highest first).
+    // Threads are not preemptive, hence a task is also blocked by the longest
+    // activation of a lower priority task. The sufficient test of R.I. Davis,
+    // A. Burns, R.J. Bril, J.J. Lukkien, "Controller Area Network (CAN) 
+    // schedulability analysis: Refuted, revisited and revised", RTS 2007:
+    //
+    //   w_i = max(B_i, C_i) + sum_{j < i} (floor(w_i / T_j) + 1) C_j
+    //   R_i = w_i + C_i
+    //
+    // response_time() returns 0 if R_i exceeds the deadline of the task.
+
+    template <typename T>
+    class response_time_analysis
+    {
+    public:
+        typedef periodic_task<T> task_type;
+
+    private:
+        std::vector<task_type> _M_tasks;
+
+    public:
+        response_time_analysis()
+        : _M_tasks()
+        {}
+
+        template <typename Iter>
+        response_time_analysis(Iter first, Iter last)
+        : _M_tasks(first, last)
+        {}
+
+        // add a task, with a priority lower than the ones already added...
+
+        void
+        push_back(const task_type &t)
+        { _M_tasks.push_back(t); }
+
+        std::size_t
+        size() const
+        { return _M_tasks.size(); }
+
+        typename T::cycles_type
+        response_time(std::size_t i) const
+        {
+            const task_type &ti = _M_tasks[i];
+            const typename T::cycles_type d = ti.relative_deadline();
+
+            typename T::cycles_type b = ti.wcet;
+            for(std::size_t j = i + 1; j < _M_tasks.size(); ++j)
+                b = std::max(b, _M_tasks[j].wcet);
+
+            typename T::cycles_type w = b, prev;
+            do {
+                prev = w;
+                w = b;
+                for(std::size_t j = 0; j < i; ++j)
+                    w += (prev / _M_tasks[j].period + 1) * _M_tasks[j].wcet;
+                if (w + ti.wcet > d)
+                    return 0;
+            }
+            while (w != prev);
+
+            return w + ti.wcet;
+        }
+
+        bool
+        schedulable() const
+        {
+            for(std::size_t i = 0; i < _M_tasks.size(); ++i)
+                if (!response_time(i))
+                    return false;
+            return true;
+        }
+
+        // would the task be schedulable at the priority level pos (0 = the highest)?
+
+        bool
+        admissible(const task_type &t, std::size_t pos) const
+        {
+            response_time_analysis r(*this);
+            r._M_tasks.insert(r._M_tasks.begin() + std::min(pos, _M_tasks.size()), t);
+            return r.schedulable();
+        }
+    };
+
+} // namespace qrt
+
+#endif /* _QRT_ADMISSION_HPP_ */
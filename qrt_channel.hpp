@@ -0,0 +1,169 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _QRT_CHANNEL_HPP_
+#define _QRT_CHANNEL_HPP_
+
+#include <qrt_thread.hpp>
+#include <qrt_lockfree.hpp>
+#include <qrt_utils.hpp>
+
+#include <atomic>
+#include <cstddef>
+
+namespace qrt {
+
+    ///////////////////// channel between qrt threads
+    //
+    // a bounded lock-free ring (spsc_ring or mpsc_ring) plus the consumer 
+    // thread, if suspended: qrt_wait_recv parks the consumer until a producer
+    // publishes (or closes the channel) and wakes it by means of the submission
+    // queue of its scheduler. No lock and no system call on either side.
+    //
+    // send() does not block: a producer backs off (e.g. qrt_force_schedule)
+    // when the channel is full.
+
+    template <typename Ring, typename Thread = qrt::thread>
+    class basic_channel
+    {
+    public:
+        typedef typename Ring::value_type value_type;
+
+    private:
+        Ring                    _M_ring;
+        std::atomic<Thread *>   _M_waiter;  /* the consumer, while suspended */
+        std::atomic<bool>       _M_closed;
+
+        void
+        _M_notify()
+        {
+            // pairs with the fence in wait()...
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (_M_waiter.load(std::memory_order_relaxed)) 
+            {
+                Thread * w = _M_waiter.exchange(0, std::memory_order_acq_rel);
+                if (w)
+                    w->wake();
+            }
+        }
+
+        bool
+        _M_ready() const
+        {
+            return !_M_ring.empty() || _M_closed.load(std::memory_order_acquire);
+        }
+
+    public:
+        basic_channel()
+        : _M_ring(), _M_waiter(0), _M_closed(false)
+        {}
+
+        basic_channel(const basic_channel &) = delete;
+        basic_channel& operator=(const basic_channel &) = delete;
+
+        // producer(s) side...
+        //
+
+        bool
+        send(const value_type &value)
+        {
+            if (!_M_ring.push(value))
+                return false;
+            _M_notify();
+            return true;
+        }
+
+        std::size_t
+        send_n(const value_type *value, std::size_t n)
+        {
+            std::size_t k = _M_ring.push_n(value, n);
+            if (k)
+                _M_notify();
+            return k;
+        }
+
+        // no more values: the consumer drains the channel, then try_recv 
+        // fails with closed() true...
+        //
+
+        void
+        close()
+        {
+            _M_closed.store(true, std::memory_order_release);
+            _M_notify();
+        }
+
+        bool
+        closed() const
+        { return _M_closed.load(std::memory_order_acquire); }
+
+        // consumer side...
+        //
+
+        bool
+        try_recv(value_type &value)
+        { return _M_ring.pop(value); }
+
+        std::size_t
+        try_recv_n(value_type *value, std::size_t n)
+        { return _M_ring.pop_n(value, n); }
+
+        // called by the consumer t with an empty channel: true if t is to be
+        // suspended (a producer will wake it), false if the channel is ready...
+        //
+
+        bool
+        wait(Thread *t)
+        {
+            if (_M_ready())
+                return false;
+
+            _M_waiter.store(t, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (!_M_ready())
+                return true;
+
+            // ready in the meantime: withdraw, unless a producer took t already
+            Thread * self = t;
+            return !_M_waiter.compare_exchange_strong(self, 0, std::memory_order_acq_rel);
+        }
+
+        std::size_t
+        size() const
+        { return _M_ring.size(); }
+
+        static constexpr std::size_t
+        capacity()
+        { return Ring::capacity(); }
+    };
+
+    template <typename Tp, std::size_t N = 1024, typename Thread = qrt::thread>
+    struct spsc_channel : public basic_channel<spsc_ring<Tp, N>, Thread> {};
+
+    template <typename Tp, std::size_t N = 1024, typename Thread = qrt::thread>
+    struct mpsc_channel : public basic_channel<mpsc_ring<Tp, N>, Thread> {};
+
+} // namespace qrt
+
+#endif /* _QRT_CHANNEL_HPP_ */
@@ -0,0 +1,579 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _QRT_CONTEXT_HPP_
+#define _QRT_CONTEXT_HPP_
+
+#if !defined(__x86_64__)
+#error "qrt_context.hpp: stackful threads are implemented for x86-64 only"
+#endif
+
+#include <qrt_thread.hpp>
+#include <qrt_utils.hpp>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <exception>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace qrt {
+
+    // context switch of stackful threads: only the callee-saved registers
+    // (System V x86-64 ABI) and the stack pointer are saved, no signal mask
+    // (unlike ucontext, no syscall is involved). The x87/SSE control words
+    // are not saved: threads must not change the floating point modes.
+    //
+    // The switch routines are emitted as top-level assembly in a COMDAT section
+    // (one copy per program), and are opaque to the compiler: no interprocedural 
+    // register allocation can assume that caller-saved registers survive them.
+    //
+    // qrt_context_swap(from, to): save the context on the current stack, store 
+    // the stack pointer in *from and resume the context saved at to.
+    //
+    // qrt_context_entry: first activation of a context, call r12(rbx) which
+    // never returns.
+
+    extern "C" void qrt_context_swap(void **from, void *to);
+    extern "C" void qrt_context_entry();
+
+    __asm__(
+        ".pushsection .text.qrt_context_swap,\"axG\",@progbits,qrt_context_swap,comdat\n"
+        ".globl  qrt_context_swap\n"
+        ".hidden qrt_context_swap\n"
+        ".type   qrt_context_swap,@function\n"
+        "qrt_context_swap:\n\t"
+        "pushq %rbp\n\t"
+        "pushq %rbx\n\t"
+        "pushq %r12\n\t"
+        "pushq %r13\n\t"
+        "pushq %r14\n\t"
+        "pushq %r15\n\t"
+        "movq  %rsp, (%rdi)\n\t"
+        "movq  %rsi, %rsp\n\t"
+        "popq  %r15\n\t"
+        "popq  %r14\n\t"
+        "popq  %r13\n\t"
+        "popq  %r12\n\t"
+        "popq  %rbx\n\t"
+        "popq  %rbp\n\t"
+        "ret\n"
+        ".size   qrt_context_swap, .-qrt_context_swap\n"
+        ".popsection\n"
+
+        ".pushsection .text.qrt_context_entry,\"axG\",@progbits,qrt_context_entry,comdat\n"
+        ".globl  qrt_context_entry\n"
+        ".hidden qrt_context_entry\n"
+        ".type   qrt_context_entry,@function\n"
+        "qrt_context_entry:\n\t"
+        "movq  %rbx, %rdi\n\t"
+        "callq *%r12\n\t"
+        "ud2\n"
+        ".size   qrt_context_entry, .-qrt_context_entry\n"
+        ".popsection\n");
+
+    namespace detail {
+
+        // prepare a stack [base, base+size) so that the first qrt_context_swap to the
+        // returned stack pointer calls fun(arg).
+        //
+
+        static inline void *
+        context_make(void *base, std::size_t size, void (*fun)(void *), void *arg)
+        {
+            uintptr_t top = (reinterpret_cast<uintptr_t>(base) + size) & ~uintptr_t(15);
+            void ** sp = reinterpret_cast<void **>(top);
+
+            *--sp = reinterpret_cast<void *>(&qrt_context_entry);  /* ret */
+            *--sp = 0;                                              /* rbp */
+            *--sp = arg;                                            /* rbx */
+            *--sp = reinterpret_cast<void *>(fun);                  /* r12 */
+            *--sp = 0;                                              /* r13 */
+            *--sp = 0;                                              /* r14 */
+            *--sp = 0;                                              /* r15 */
+            return sp;
+        }
+    }
+
+    ///////////////////// stack policies
+
+    // a Stack policy provides allocate(size) and deallocate(ptr, size); an
+    // instance lives in each stackful thread.
+
+    // one private mapping per stack, with a guard page below it...
+    //
+
+    struct mmap_stack
+    {
+        static void *
+        allocate(std::size_t size)
+        {
+            const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            void * p = ::mmap(0, size + page, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                throw std::runtime_error("mmap");
+            if (::mprotect(p, page, PROT_NONE) != 0) {
+                ::munmap(p, size + page);
+                throw std::runtime_error("mprotect");
+            }
+            return static_cast<char *>(p) + page;
+        }
+
+        static void
+        deallocate(void *p, std::size_t size)
+        {
+            const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+            ::munmap(static_cast<char *>(p) - page, size + page);
+        }
+    };
+
+    // a pool of fixed-size stacks carved out of a single mapping, with a
+    // PROT_NONE guard below each stack:
+    //
+    //   | guard | stack 0 | guard | stack 1 | ...
+    //
+    // With hugepages the mapping is backed by 2M pages (MAP_HUGETLB, or
+    // transparent hugepages when no hugetlb page is reserved). A huge page 
+    // cannot be partially protected, hence guards and stacks are rounded to 
+    // 2M: a 64K stack takes 4M of address space and 2M of locked memory. For
+    // thousands of threads, drop the guards (guards = false): the stacks are
+    // then packed at page granularity and only the mapping is rounded to 2M.
+    //
+    // lock() prefaults and mlocks all the stacks (not the guards), once: pass
+    // the pool to basic_scheduler::lock_at_start to have it done by start().
+    // Afterwards allocate and deallocate never enter the kernel (LIFO 
+    // recycling, hot stacks first); a stackful thread gives its stack back as
+    // soon as it completes.
+    //
+    // Stacks are given back by the scheduler threads, hence deallocate is
+    // lock-free and may run concurrently (the link is kept in the stack being
+    // returned), and several schedulers can share a pool. allocate, as the
+    // frame_arena, is for one thread at a time: threads are to be created by
+    // a single thread.
+
+    class stack_pool : public lockable_memory
+    {
+    public:
+        static const std::size_t hugepage_size = 2 * 1024 * 1024;
+
+    private:
+        char *              _M_base;
+        std::size_t         _M_length;
+        std::size_t         _M_stack_size;
+        std::size_t         _M_guard;
+        std::size_t         _M_count;
+        std::vector<void *> _M_free;        /* allocating thread */
+        std::atomic<void *> _M_returned;    /* given back, any thread */
+        bool                _M_locked;
+
+        static std::size_t
+        _S_round(std::size_t n, std::size_t g)
+        { return (n + g - 1) / g * g; }
+
+        static void *&
+        _S_link(void *p)
+        { return * static_cast<void **>(p); }
+
+        // take the stacks given back so far, the last returned on top...
+        //
+
+        void
+        _M_reclaim()
+        {
+            void * p = _M_returned.exchange(0, std::memory_order_acquire);
+            const std::size_t n = _M_free.size();
+            for(; p; p = _S_link(p))
+                _M_free.push_back(p);
+            std::reverse(_M_free.begin() + n, _M_free.end());
+        }
+
+    public:
+        stack_pool(std::size_t count, std::size_t stack_size, bool hugepages = false, bool guards = true)
+        : _M_base(), _M_length(), _M_stack_size(), _M_guard(), _M_count(count), _M_free(), _M_returned(0), _M_locked(false)
+        {
+            const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+            _M_guard      = guards ? (hugepages ? hugepage_size : page) : 0;
+            _M_stack_size = _S_round(stack_size, hugepages && guards ? hugepage_size : page);
+            _M_length     = _S_round(count * (_M_guard + _M_stack_size), hugepages ? hugepage_size : page);
+
+            void * p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+            if (hugepages)
+                p = ::mmap(0, _M_length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+#endif
+            if (p == MAP_FAILED) {
+                p = ::mmap(0, _M_length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+                if (p == MAP_FAILED)
+                    throw std::runtime_error("mmap");
+#ifdef MADV_HUGEPAGE
+                if (hugepages)
+                    ::madvise(p, _M_length, MADV_HUGEPAGE);
+#endif
+            }
+            _M_base = static_cast<char *>(p);
+
+            _M_free.reserve(count);
+            for(std::size_t i = count; i > 0; --i)
+            {
+                char * slot = _M_base + (i-1) * (_M_guard + _M_stack_size);
+                if (_M_guard && ::mprotect(slot, _M_guard, PROT_NONE) != 0) {
+                    ::munmap(_M_base, _M_length);
+                    throw std::runtime_error("mprotect");
+                }
+                _M_free.push_back(slot + _M_guard);
+            }
+        }
+
+        ~stack_pool()
+        {
+            ::munmap(_M_base, _M_length);
+        }
+
+        stack_pool(const stack_pool &) = delete;
+        stack_pool& operator=(const stack_pool &) = delete;
+
+        // prefault and mlock the stacks (not the guards), once...
+        //
+
+        void
+        lock()
+        {
+            if (_M_locked)
+                return;
+            if (_M_guard)
+                for(std::size_t i = 0; i < _M_count; ++i)
+                    prefault_and_lock(_M_base + i * (_M_guard + _M_stack_size) + _M_guard, _M_stack_size);
+            else
+                prefault_and_lock(_M_base, _M_count * _M_stack_size);
+            _M_locked = true;
+        }
+
+        bool
+        locked() const
+        { return _M_locked; }
+
+        void *
+        allocate(std::size_t size)
+        {
+            if (size > _M_stack_size)
+                throw std::runtime_error("qrt::stack_pool: stack too large");
+            if (_M_free.empty())
+                _M_reclaim();
+            if (_M_free.empty())
+                throw std::runtime_error("qrt::stack_pool: exhausted");
+
+            void * p = _M_free.back();
+            _M_free.pop_back();
+            return p;
+        }
+
+        void
+        deallocate(void *p, std::size_t)
+        {
+            void * head = _M_returned.load(std::memory_order_relaxed);
+            do {
+                _S_link(p) = head;
+            }
+            while (!_M_returned.compare_exchange_weak(head, p, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        std::size_t
+        stack_size() const
+        { return _M_stack_size; }
+
+        std::size_t
+        capacity() const
+        { return _M_count; }
+
+        // from the allocating thread...
+        //
+
+        std::size_t
+        available() const
+        { 
+            std::size_t n = _M_free.size();
+            for(void * p = _M_returned.load(std::memory_order_acquire); p; p = _S_link(p))
+                ++n;
+            return n; 
+        }
+
+        static stack_pool *&
+        current()
+        {
+            static thread_local stack_pool * p;
+            return p;
+        }
+
+        // make a pool current for the threads created in this scope...
+        //
+
+        struct scope
+        {
+            stack_pool * _M_prev;
+
+            explicit scope(stack_pool &p)
+            : _M_prev(current())
+            { current() = &p; }
+
+            ~scope()
+            { current() = _M_prev; }
+
+            scope(const scope &) = delete;
+            scope& operator=(const scope &) = delete;
+        };
+    };
+
+    // stacks taken from the stack_pool current at the thread construction...
+    //
+
+    class pool_stack
+    {
+        stack_pool * _M_pool;
+
+    public:
+        pool_stack()
+        : _M_pool(stack_pool::current())
+        {
+            if (!_M_pool)
+                throw std::runtime_error("qrt::pool_stack: no current stack_pool");
+        }
+
+        void *
+        allocate(std::size_t size)
+        { return _M_pool->allocate(size); }
+
+        void
+        deallocate(void *p, std::size_t size)
+        { _M_pool->deallocate(p, size); }
+    };
+
+    ///////////////////// basic_stackful_thread
+    //
+    // a basic_thread with its own stack: the body (main) can suspend from any
+    // depth of nested calls by means of context_switch/sleep_for/until/schedule,
+    // which mirror the stackless macros of qrt_coroutines.hpp.
+
+    template <typename T, typename Native,
+              template <typename, typename> class Heap = qrt::random_access::vector_heap,
+              typename Stack = mmap_stack>
+    class basic_stackful_thread : public basic_thread<T, Native, Heap>
+    {
+    public:
+        static const std::size_t default_stack_size = 64 * 1024;
+
+    private:
+        Stack                   _M_alloc;       /* stack policy */
+        void *                  _M_sp;          /* context of the thread */
+        void *                  _M_caller;      /* context of the scheduler */
+        void *                  _M_stack;
+        std::size_t             _M_stack_size;
+        typename T::cycles_type _M_pending;     /* argument of run() */
+        typename T::cycles_type _M_deadline;    /* next deadline, returned by run() */
+        bool                    _M_done;
+
+        static void
+        _S_entry(void *arg)
+        {
+            basic_stackful_thread * t = static_cast<basic_stackful_thread *>(arg);
+
+            t->incr();
+            try {
+                t->main();
+            }
+            catch(...) {
+                std::terminate();
+            }
+            t->decr();
+
+            t->_M_done = true;
+            qrt_context_swap(&t->_M_sp, t->_M_caller);
+        }
+
+        // back to the Stack policy, once main() has returned...
+        //
+
+        void
+        _M_release_stack()
+        {
+            if (!_M_stack)
+                return;
+            _M_alloc.deallocate(_M_stack, _M_stack_size);
+            _M_stack = 0;
+        }
+
+    protected:
+        basic_stackful_thread(const typename T::cycles_type &b, const typename T::cycles_type &e,
+                              std::size_t stack_size = default_stack_size)
+        : basic_thread<T, Native, Heap>(b, e),
+          _M_alloc(),
+          _M_sp(),
+          _M_caller(),
+          _M_stack(_M_alloc.allocate(stack_size)),
+          _M_stack_size(stack_size),
+          _M_pending(),
+          _M_deadline(),
+          _M_done(false)
+        {
+            _M_sp = detail::context_make(_M_stack, _M_stack_size, &_S_entry, this);
+        }
+
+        ~basic_stackful_thread()
+        {
+            _M_release_stack();
+        }
+
+        // thread body...
+        //
+
+        virtual void main() = 0;
+
+        // the deadline of the previous activation (the argument of run)...
+        //
+
+        typename T::cycles_type
+        pending() const
+        { return _M_pending; }
+
+        // go back to the scheduler, to be resumed at deadline (see qrt_context_switch)
+        //
+
+        void
+        context_switch(typename T::cycles_type deadline)
+        {
+            _M_deadline = deadline;
+            qrt_context_swap(&_M_sp, _M_caller);
+        }
+
+        // see qrt_force_schedule
+        //
+
+        void
+        until(typename T::cycles_type deadline)
+        {
+            context_switch(deadline);
+            T::busywait_until(deadline);
+        }
+
+        // see qrt_sleep_for
+        //
+
+        void
+        sleep_for(typename T::cycles_type ticks)
+        {
+            this->_M_tstamp = T::get_cycles() + ticks;
+            context_switch(this->_M_tstamp);
+            T::busywait_until(this->_M_tstamp);
+        }
+
+        // see qrt_next_period
+        //
+
+        void
+        next_period(typename T::cycles_type period)
+        {
+            this->_M_tstamp = this->next_deadline() + period;
+            context_switch(this->_M_tstamp);
+            T::busywait_until(this->next_deadline());
+        }
+
+        // see qrt_coalesce
+        //
+
+        void
+        coalesce_until(typename T::cycles_type deadline, typename T::cycles_type slack)
+        {
+            context_switch(this->coalesce(deadline, slack));
+            T::busywait_until(this->next_deadline() - slack);
+        }
+
+        // see qrt_wait_fd, returns the readiness
+        //
+
+        unsigned
+        wait_fd(int fd, unsigned events)
+        {
+            context_switch(this->watch_fd(fd, events));
+            return this->revents();
+        }
+
+        // see qrt_wait_recv
+        //
+
+        template <typename Channel>
+        void
+        wait_recv(Channel &channel)
+        {
+            while (channel.wait(this))
+                context_switch(this->suspend());
+        }
+
+        // see qrt_schedule
+        //
+
+        void
+        schedule(typename T::cycles_type deadline)
+        {
+            if (unlikely(!this->_M_heap->empty()) && (_M_pending < deadline))
+                context_switch(deadline);
+            T::busywait_until(deadline);
+        }
+
+    public:
+        typename T::cycles_type
+        run(typename T::cycles_type pending)
+        {
+            if (unlikely(_M_done))
+                return 0;
+
+            _M_pending = pending;
+            qrt_context_swap(&_M_caller, _M_sp);
+
+            // completed: the stack is no longer in use...
+            if (_M_done) {
+                _M_release_stack();
+                return 0;
+            }
+            return _M_deadline;
+        }
+    };
+
+#ifdef __linux__
+
+    typedef basic_stackful_thread<qrt::this_cpu, linux_native_thread, qrt::random_access::vector_heap> stackful_thread;
+    typedef basic_stackful_thread<qrt::this_cpu, linux_native_thread, qrt::random_access::vector_heap, pool_stack> pooled_stackful_thread;
+
+#else
+
+    typedef basic_stackful_thread<qrt::this_cpu, null_native_thread, qrt::random_access::vector_heap> stackful_thread;
+    typedef basic_stackful_thread<qrt::this_cpu, null_native_thread, qrt::random_access::vector_heap, pool_stack> pooled_stackful_thread;
+
+#endif
+
+} // namespace qrt
+
+#endif /* _QRT_CONTEXT_HPP_ */
@@ -47,13 +47,13 @@ inline bool unlikely(Tp x)
 #define qrt_schedule(deadline,pending) if (unlikely(!_M_heap->empty()) && ( pending < deadline )) \
     do { _M_state = __LINE__; return deadline; case __LINE__:; } \
 while(0); \
-qrt::this_cpu::busywait_until(deadline)
+clock_type::busywait_until(deadline)
 
 
 #define qrt_force_schedule(deadline) do { \
     _M_state = __LINE__; return deadline; case __LINE__:; } \
 while(0); \
-qrt::this_cpu::busywait_until(deadline)
+clock_type::busywait_until(deadline)
 
 
 #define qrt_context_switch(deadline) do { \
@@ -62,10 +62,45 @@ while(0);
 
 
 #define qrt_sleep_for(ticks) do { \
-    _M_tstamp = qrt::this_cpu::get_cycles() + ticks; \
+    _M_tstamp = clock_type::get_cycles() + ticks; \
     _M_state = __LINE__; return _M_tstamp; case __LINE__:; } \
 while(0); \
-qrt::this_cpu::busywait_until(_M_tstamp)
+clock_type::busywait_until(_M_tstamp)
+
+
+/* periodic activation, based on the deadline of the current one (no drift). 
+   The scheduler may move it forward, according to the overrun policy. */
+
+#define qrt_next_period(period) do { \
+    _M_tstamp = this->next_deadline() + period; \
+    _M_state = __LINE__; return _M_tstamp; case __LINE__:; } \
+while(0); \
+clock_type::busywait_until(this->next_deadline())
+
+
+/* like qrt_force_schedule, tolerating an activation up to slack cycles early
+   (slack < deadline), so that the scheduler can dispatch it in a batch. */
+
+#define qrt_coalesce(deadline,slack) do { \
+    _M_state = __LINE__; return this->coalesce(deadline, slack); case __LINE__:; } \
+while(0); \
+clock_type::busywait_until(this->next_deadline() - (slack))
+
+
+/* suspend until fd is ready for the events (POLLIN, POLLOUT...), see 
+   event_source; this->revents() returns the readiness. */
+
+#define qrt_wait_fd(fd,events) do { \
+    _M_state = __LINE__; return this->watch_fd(fd, events); case __LINE__:; } \
+while(0)
+
+
+/* suspend until the channel has values or is closed (see basic_channel), 
+   then take them with try_recv/try_recv_n. */
+
+#define qrt_wait_recv(channel) while((channel).wait(this)) do { \
+    _M_state = __LINE__; return this->suspend(); case __LINE__:; } \
+while(0)
 
 
 #endif /* _QRT_COROUTINES_HPP_ */
@@ -0,0 +1,284 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _QRT_EVENT_HPP_
+#define _QRT_EVENT_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace qrt {
+
+    ///////////////////// readiness event source
+    //
+    // a per-scheduler source of I/O readiness: threads suspended by qrt_wait_fd
+    // are watched by the scheduler (one-shot) and made eligible as soon as their
+    // fd is ready. Events are poll(2) bits (POLLIN, POLLOUT...). Both watch() and
+    // harvest() are called by the scheduler thread only.
+
+    struct event_ready
+    {
+        void *      cookie;     /* the waiting thread */
+        unsigned    revents;
+    };
+
+    class event_source
+    {
+    public:
+        virtual ~event_source() 
+        {}
+
+        // watch fd for the events, once...
+        //
+
+        virtual void watch(int fd, unsigned events, void *cookie) = 0;
+
+        // non-blocking: store up to n ready events, return the number...
+        //
+
+        virtual std::size_t harvest(event_ready *ready, std::size_t n) = 0;
+    };
+
+#ifdef __linux__
+
+    ///////////////////// epoll_source
+    //
+    // epoll with EPOLLONESHOT and zero timeout: one epoll_wait per harvest. 
+    // A fd is watched by one thread at a time.
+
+    class epoll_source : public event_source
+    {
+        int _M_fd;
+
+    public:
+        epoll_source()
+        : _M_fd(::epoll_create1(EPOLL_CLOEXEC))
+        {
+            if (_M_fd < 0)
+                throw std::runtime_error("epoll_create1");
+        }
+
+        ~epoll_source()
+        {
+            ::close(_M_fd);
+        }
+
+        epoll_source(const epoll_source &) = delete;
+        epoll_source& operator=(const epoll_source &) = delete;
+
+        void
+        watch(int fd, unsigned events, void *cookie)
+        {
+            epoll_event ev;
+            ev.events   = events | EPOLLONESHOT;
+            ev.data.ptr = cookie;
+
+            // a one-shot fd stays registered (disabled): re-arm it...
+            if (::epoll_ctl(_M_fd, EPOLL_CTL_MOD, fd, &ev) < 0 && 
+                ::epoll_ctl(_M_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+                throw std::runtime_error("epoll_ctl");
+        }
+
+        std::size_t
+        harvest(event_ready *ready, std::size_t n)
+        {
+            epoll_event ev[64];
+            int r = ::epoll_wait(_M_fd, ev, static_cast<int>(std::min<std::size_t>(n, 64)), 0);
+            for(int i = 0; i < r; ++i)
+            {
+                ready[i].cookie  = ev[i].data.ptr;
+                ready[i].revents = ev[i].events;
+            }
+            return r > 0 ? r : 0;
+        }
+    };
+
+    ///////////////////// uring_source
+    //
+    // io_uring with one-shot IORING_OP_POLL_ADD requests. Completions are read
+    // from the shared CQ ring, hence a harvest with nothing ready costs no 
+    // system call: io_uring_enter is issued only to submit new watches (once
+    // per harvest, in batch) and to flush an overflown CQ ring. The same fd may
+    // be watched by many threads.
+
+    class uring_source : public event_source
+    {
+        int                 _M_fd;
+        io_uring_params     _M_params;
+
+        void *              _M_sq_ring;
+        std::size_t         _M_sq_length;
+        void *              _M_cq_ring;
+        std::size_t         _M_cq_length;
+        io_uring_sqe *      _M_sqe;
+
+        unsigned *          _M_sq_head;
+        unsigned *          _M_sq_tail;
+        unsigned *          _M_sq_flags;
+        unsigned *          _M_sq_array;
+        unsigned            _M_sq_mask;
+
+        unsigned *          _M_cq_head;
+        unsigned *          _M_cq_tail;
+        io_uring_cqe *      _M_cqe;
+        unsigned            _M_cq_mask;
+
+        unsigned            _M_pending;     /* sqes not submitted yet */
+
+        void *
+        _M_map(std::size_t length, off_t offset)
+        {
+            void * p = ::mmap(0, length, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, _M_fd, offset);
+            if (p == MAP_FAILED)
+                throw std::runtime_error("io_uring: mmap");
+            return p;
+        }
+
+        int
+        _M_enter(unsigned submit, unsigned flags)
+        {
+            return static_cast<int>(::syscall(__NR_io_uring_enter, _M_fd, submit, 0, flags, 0, 0));
+        }
+
+        void
+        _M_submit()
+        {
+            while (_M_pending)
+            {
+                int n = _M_enter(_M_pending, 0);
+                if (n < 0)
+                    throw std::runtime_error("io_uring_enter");
+                _M_pending -= n;
+            }
+        }
+
+    public:
+        explicit uring_source(unsigned entries = 256)
+        : _M_fd(), _M_params(), _M_sq_ring(), _M_sq_length(), _M_cq_ring(), _M_cq_length(), _M_sqe(), 
+          _M_sq_head(), _M_sq_tail(), _M_sq_flags(), _M_sq_array(), _M_sq_mask(), 
+          _M_cq_head(), _M_cq_tail(), _M_cqe(), _M_cq_mask(), _M_pending()
+        {
+            _M_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &_M_params));
+            if (_M_fd < 0)
+                throw std::runtime_error("io_uring_setup");
+
+            _M_sq_length = _M_params.sq_off.array + _M_params.sq_entries * sizeof(unsigned);
+            _M_cq_length = _M_params.cq_off.cqes  + _M_params.cq_entries * sizeof(io_uring_cqe);
+
+            if (_M_params.features & IORING_FEAT_SINGLE_MMAP)
+                _M_sq_length = _M_cq_length = std::max(_M_sq_length, _M_cq_length);
+
+            _M_sq_ring = _M_map(_M_sq_length, IORING_OFF_SQ_RING);
+            _M_cq_ring = _M_params.features & IORING_FEAT_SINGLE_MMAP ? _M_sq_ring : _M_map(_M_cq_length, IORING_OFF_CQ_RING);
+            _M_sqe     = static_cast<io_uring_sqe *>(_M_map(_M_params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+
+            char * sq = static_cast<char *>(_M_sq_ring);
+            char * cq = static_cast<char *>(_M_cq_ring);
+
+            _M_sq_head  = reinterpret_cast<unsigned *>(sq + _M_params.sq_off.head);
+            _M_sq_tail  = reinterpret_cast<unsigned *>(sq + _M_params.sq_off.tail);
+            _M_sq_flags = reinterpret_cast<unsigned *>(sq + _M_params.sq_off.flags);
+            _M_sq_array = reinterpret_cast<unsigned *>(sq + _M_params.sq_off.array);
+            _M_sq_mask  = *reinterpret_cast<unsigned *>(sq + _M_params.sq_off.ring_mask);
+
+            _M_cq_head  = reinterpret_cast<unsigned *>(cq + _M_params.cq_off.head);
+            _M_cq_tail  = reinterpret_cast<unsigned *>(cq + _M_params.cq_off.tail);
+            _M_cqe      = reinterpret_cast<io_uring_cqe *>(cq + _M_params.cq_off.cqes);
+            _M_cq_mask  = *reinterpret_cast<unsigned *>(cq + _M_params.cq_off.ring_mask);
+        }
+
+        ~uring_source()
+        {
+            ::munmap(_M_sqe, _M_params.sq_entries * sizeof(io_uring_sqe));
+            if (_M_cq_ring != _M_sq_ring)
+                ::munmap(_M_cq_ring, _M_cq_length);
+            ::munmap(_M_sq_ring, _M_sq_length);
+            ::close(_M_fd);
+        }
+
+        uring_source(const uring_source &) = delete;
+        uring_source& operator=(const uring_source &) = delete;
+
+        void
+        watch(int fd, unsigned events, void *cookie)
+        {
+            unsigned tail = *_M_sq_tail;
+
+            if (tail - __atomic_load_n(_M_sq_head, __ATOMIC_ACQUIRE) == _M_params.sq_entries)
+                _M_submit();    /* the SQ ring is full */
+
+            unsigned index = tail & _M_sq_mask;
+            io_uring_sqe & sqe = _M_sqe[index];
+
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode        = IORING_OP_POLL_ADD;
+            sqe.fd            = fd;
+            sqe.poll32_events = events;
+            sqe.user_data     = reinterpret_cast<uint64_t>(cookie);
+
+            _M_sq_array[index] = index;
+            __atomic_store_n(_M_sq_tail, tail + 1, __ATOMIC_RELEASE);
+            _M_pending++;
+        }
+
+        std::size_t
+        harvest(event_ready *ready, std::size_t n)
+        {
+            if (_M_pending)
+                _M_submit();
+
+            if (__atomic_load_n(_M_sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)
+                _M_enter(0, IORING_ENTER_GETEVENTS);
+
+            unsigned head = *_M_cq_head;
+            unsigned tail = __atomic_load_n(_M_cq_tail, __ATOMIC_ACQUIRE);
+            std::size_t k = 0;
+
+            for(; head != tail && k < n; ++head, ++k)
+            {
+                const io_uring_cqe & cqe = _M_cqe[head & _M_cq_mask];
+                ready[k].cookie  = reinterpret_cast<void *>(cqe.user_data);
+                ready[k].revents = cqe.res < 0 ? POLLERR : static_cast<unsigned>(cqe.res);
+            }
+
+            __atomic_store_n(_M_cq_head, head, __ATOMIC_RELEASE);
+            return k;
+        }
+    };
+
+#endif
+
+} // namespace qrt
+
+#endif /* _QRT_EVENT_HPP_ */
@@ -0,0 +1,348 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _QRT_GROUP_HPP_
+#define _QRT_GROUP_HPP_
+
+#include <qrt_thread.hpp>
+#include <qrt_lockfree.hpp>
+#include <qrt_utils.hpp>
+#include <qrt_topology.hpp>
+
+#include <stdexcept>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+namespace qrt {
+
+    ///////////////////// scheduler_group
+    //
+    // A set of basic_schedulers, each pinned to its own cpu. Every scheduler
+    // keeps serving its private heap; when it falls behind (the heap top is
+    // already overdue) it sheds the overdue threads into its work-stealing
+    // deque. A scheduler whose next deadline is more than slack() cycles away
+    // steals them from the top of the deques of its peers and, from then on,
+    // the thread belongs to the thief's heap. The owner takes the shed threads
+    // nobody stole back first (from the top as well, the most overdue first),
+    // so that they keep their EDF order against the rest of its heap.
+    //
+    // The owner only touches the bottom of its deque, hence in the common
+    // case (no backlog) the dispatch path stays uncontended.
+
+    template <typename T,
+              typename Native = null_native_thread,
+              template <typename, typename> class Heap = qrt::random_access::vector_heap,
+              typename Stat = stat_disabled >
+    class scheduler_group
+    {
+    public:
+        typedef basic_scheduler<T, Native, Heap, Stat>  sched_type;
+        typedef basic_thread<T, Native, Heap>           thread_type;
+        typedef work_stealing_deque<thread_type>        deque_type;
+
+        // max number of threads shed per dispatch...
+
+        static const std::size_t shed_batch = 8;
+
+    private:
+        std::vector<std::unique_ptr<sched_type> >   _M_sched;
+        std::vector<std::unique_ptr<deque_type> >   _M_deque;
+        std::vector<cpu_mask>                       _M_cpus;
+
+        typename T::cycles_type                     _M_slack;
+        std::size_t                                 _M_next;
+
+        char                                        _M_pad0[cacheline_size];
+        std::atomic<int>                            _M_live;
+        char                                        _M_pad1[cacheline_size - sizeof(std::atomic<int>)];
+        std::atomic<unsigned long>                  _M_steals;
+
+        void
+        _M_init()
+        {
+            if (_M_cpus.empty())
+                throw std::runtime_error("qrt::scheduler_group: empty group");
+
+            for(std::size_t i = 0; i < _M_cpus.size(); ++i)
+            {
+                _M_sched.push_back(std::unique_ptr<sched_type>(new sched_type));
+                _M_deque.push_back(std::unique_ptr<deque_type>(new deque_type));
+                _M_sched.back()->_M_group = this;
+                _M_sched.back()->_M_slot  = i;
+            }
+        }
+
+        // move the overdue threads of the owner to its deque...
+        //
+
+        void
+        _M_shed(sched_type &s, typename T::cycles_type now)
+        {
+            deque_type &dq = * _M_deque[s._M_slot];
+
+            for(std::size_t n = 0; n < shed_batch && !s._M_heap.empty() && s._M_heap.top().first < now; ++n)
+            {
+                typename sched_type::heap_type::value_type e = s._M_heap.pop();
+                e.second->next_deadline(e.first);
+                if (!dq.push(e.second)) {
+                    s._M_push(e.first, e.second);
+                    break;
+                }
+            }
+        }
+
+        thread_type *
+        _M_steal(sched_type &s)
+        {
+            const std::size_t n = _M_deque.size();
+            for(std::size_t i = 1; i < n; ++i)
+            {
+                thread_type * t = _M_deque[(s._M_slot + i) % n]->steal();
+                if (t) {
+                    t->set_heap(s._M_heap);
+                    _M_steals.fetch_add(1, std::memory_order_relaxed);
+                    return t;
+                }
+            }
+            return 0;
+        }
+
+    public:
+        explicit scheduler_group(const std::vector<int> &cpus)
+        : _M_sched(), _M_deque(), _M_cpus(), _M_slack(), _M_next(), _M_pad0(), _M_live(0), _M_pad1(), _M_steals(0)
+        {
+            for(int n : cpus)
+                _M_cpus.push_back(cpu_mask::single(n));
+            _M_init();
+        }
+
+        // one scheduler per affinity mask, e.g. the cpus of a qrt::place()...
+        //
+
+        explicit scheduler_group(const std::vector<cpu_mask> &cpus)
+        : _M_sched(), _M_deque(), _M_cpus(cpus), _M_slack(), _M_next(), _M_pad0(), _M_live(0), _M_pad1(), _M_steals(0)
+        {
+            _M_init();
+        }
+
+        explicit scheduler_group(std::size_t n)
+        : _M_sched(), _M_deque(), _M_cpus(), _M_slack(), _M_next(), _M_pad0(), _M_live(0), _M_pad1(), _M_steals(0)
+        {
+            for(std::size_t i = 0; i < n; ++i)
+                _M_cpus.push_back(cpu_mask::single(static_cast<int>(i)));
+            _M_init();
+        }
+
+        ~scheduler_group()
+        {
+            join();
+        }
+
+        scheduler_group(const scheduler_group &) = delete;
+        scheduler_group& operator=(const scheduler_group &) = delete;
+
+        std::size_t
+        size() const
+        { return _M_sched.size(); }
+
+        sched_type &
+        operator[](std::size_t n)
+        { return * _M_sched[n]; }
+
+        const sched_type &
+        operator[](std::size_t n) const
+        { return * _M_sched[n]; }
+
+        // schedule a thread on the group (round-robin)...
+        //
+
+        void
+        operator()(thread_type *t, typename T::cycles_type deadline = 0)
+        {
+            (* _M_sched[_M_next++ % _M_sched.size()])(t, deadline);
+        }
+
+        // a scheduler steals only if its next deadline is at least slack cycles away
+        //
+
+        typename T::cycles_type
+        slack() const
+        { return _M_slack; }
+
+        void
+        slack(typename T::cycles_type value)
+        { _M_slack = value; }
+
+        void
+        schedparam(int _policy, int _prio)
+        {
+            for(std::size_t i = 0; i < _M_sched.size(); ++i)
+                _M_sched[i]->schedparam(_policy, _prio);
+        }
+
+        void
+        start()
+        {
+            for(std::size_t i = 0; i < _M_sched.size(); ++i)
+            {
+                _M_sched[i]->affinity(_M_cpus[i]);
+                _M_sched[i]->start();
+            }
+        }
+
+        void
+        join()
+        {
+            for(std::size_t i = 0; i < _M_sched.size(); ++i)
+                _M_sched[i]->join();
+        }
+
+        // threads not yet terminated...
+        //
+
+        int
+        live() const
+        { return _M_live.load(std::memory_order_acquire); }
+
+        // threads migrated so far...
+        //
+
+        unsigned long
+        steals() const
+        { return _M_steals.load(std::memory_order_relaxed); }
+
+        // statistics of the whole group (a snapshot, after join)...
+        //
+
+        stat_type<T>
+        stat() const
+        {
+            stat_type<T> s;
+            for(std::size_t i = 0; i < _M_sched.size(); ++i)
+                s.merge(_M_sched[i]->stat());
+            return s;
+        }
+
+        // hooks called by the basic_scheduler...
+        //
+
+        void
+        enter(thread_type *)
+        {
+            _M_live.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void
+        leave(thread_type *)
+        {
+            _M_live.fetch_sub(1, std::memory_order_release);
+        }
+
+        thread_type *
+        eligible(sched_type &s)
+        {
+            deque_type &dq = * _M_deque[s._M_slot];
+
+            for(;;)
+            {
+                s.drain();
+                s._M_harvest();
+
+                // the shed threads nobody stole come first, in deadline order
+                // (from the top: the most overdue), unless the heap holds an
+                // earlier one...
+
+                while (!dq.empty())
+                {
+                    thread_type * t = dq.steal();
+                    if (!t)
+                        continue;       /* lost against a thief */
+                    if (!s._M_heap.empty() && s._M_heap.top().first < t->next_deadline()) {
+                        s._M_push(t->next_deadline(), t);
+                        break;
+                    }
+                    return t;
+                }
+
+                typename T::cycles_type now = T::get_cycles();
+
+                // the head is due: dispatch it and shed the backlog, if any...
+
+                if (!s._M_heap.empty() && s._M_heap.top().first <= now)
+                {
+                    thread_type * t = s._M_heap.pop_value();
+                    if (unlikely(!s._M_heap.empty() && s._M_heap.top().first < now))
+                        _M_shed(s, now);
+                    return t;
+                }
+
+                // help the peers, as long as there is enough slack...
+
+                if (s._M_heap.empty() || s._M_heap.top().first > now + _M_slack)
+                {
+                    thread_type * t;
+                    if ((t = _M_steal(s)))
+                        return t;
+
+                    if (s._M_heap.empty() && live() <= 0)
+                        return 0;
+
+                    // an abort (or any stop, once the own heap is empty) is for
+                    // the scheduler to handle, and a persistent member with no
+                    // threads of its own parks in wait_for_work()...
+                    const int stop = s.stop_pending();
+                    if (stop == stop_mode::abort || 
+                        (s._M_heap.empty() && (stop != stop_mode::none || s._M_persistent)))
+                        return 0;
+
+                    // threads parked on their fd: back to the scheduler, which
+                    // keeps harvesting (and checks for a stop)...
+                    if (s._M_waiting)
+                        return 0;
+
+                    detail::cpu_relax();
+                    continue;
+                }
+
+                return s._M_heap.pop_value();
+            }
+        }
+    };
+
+#ifdef __linux__
+
+    typedef scheduler_group< qrt::this_cpu, linux_native_thread, qrt::random_access::vector_heap, stat_disabled > deadline_scheduler_group;
+    typedef scheduler_group< qrt::this_cpu, linux_native_thread, qrt::random_access::vector_heap, stat_enabled  > stat_deadline_scheduler_group;
+    typedef scheduler_group< qrt::this_cpu, linux_native_thread, qrt::random_access::vector_heap, stat_per_thread > thread_stat_deadline_scheduler_group;
+
+#else
+
+    typedef scheduler_group< qrt::this_cpu, null_native_thread, qrt::random_access::vector_heap, stat_disabled > deadline_scheduler_group;
+    typedef scheduler_group< qrt::this_cpu, null_native_thread, qrt::random_access::vector_heap, stat_enabled  > stat_deadline_scheduler_group;
+    typedef scheduler_group< qrt::this_cpu, null_native_thread, qrt::random_access::vector_heap, stat_per_thread > thread_stat_deadline_scheduler_group;
+
+#endif
+
+} // namespace qrt
+
+#endif /* _QRT_GROUP_HPP_ */
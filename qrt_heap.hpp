@@ -23,16 +23,41 @@
 #ifndef _QRT_HEAP_HPP_
 #define _QRT_HEAP_HPP_ 
 
+#include <qrt_utils.hpp>
+
+#include <type_traits>
 #include <functional>
 #include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <cassert>
+#include <array>
+#include <new>
 #include <vector>
 #include <deque>
 #include <queue>
 #include <memory>
 #include <map>
 
+#if defined(__SSE4_1__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
 namespace qrt { 
 
+    namespace detail {
+
+        // a rebuild of a heap of n elements is O(n), k pushes O(k log n)...
+        //
+        inline bool
+        rebuild_heap(std::size_t n, std::size_t k)
+        {
+            return k * (64 - __builtin_clzll(n | 1)) > n;
+        }
+    }
+
     // SGI http://www.sgi.com/tech/stl/make_heap.html: 
     // A heap is a particular way of ordering the elements in a range of Random Access Iterators [f, l)
     // This heap implementation is based on the SGI algorithm make_heap/pop_heap/push_heap.
@@ -95,6 +120,22 @@ namespace qrt {
                 return ret; 
             }
 
+            // push a range of value_type, with a single rebuild if cheaper...
+            //
+            template <typename Iter>
+            void
+            push_bulk(Iter first, Iter last)
+            {
+                const std::size_t n = _M_cont.size();
+                _M_cont.insert(_M_cont.end(), first, last);
+
+                if (detail::rebuild_heap(n, _M_cont.size() - n))
+                    std::make_heap(_M_cont.begin(), _M_cont.end(), comp());
+                else
+                    for(std::size_t i = n; i < _M_cont.size(); ++i)
+                        std::push_heap(_M_cont.begin(), _M_cont.begin() + i + 1, comp());
+            }
+
             value_type &
             top() 
             { return _M_cont.front(); }
@@ -175,7 +216,7 @@ namespace qrt {
                 return ret; 
             }
 
-            value_type &
+            const value_type &
             top() 
             { return _M_pq.top(); }
 
@@ -188,11 +229,320 @@ namespace qrt {
             { return _M_pq.empty(); } 
 
         };
+
+        // overflow policies for static_heap...
+        //
+
+        struct overflow_reject      /* push() returns false */
+        {
+            static bool 
+            overflow()
+            { return false; }
+        };
+
+        struct overflow_throw       /* push() throws std::length_error */
+        {
+            static bool 
+            overflow()
+            { throw std::length_error("qrt::static_heap: overflow"); }
+        };
+
+        struct overflow_assert      /* push() asserts (and rejects, with NDEBUG) */
+        {
+            static bool 
+            overflow()
+            { 
+                assert(!"qrt::static_heap: overflow"); 
+                return false; 
+            }
+        };
+
+        // fixed-capacity heap, stored inline: push never allocates. 
+        // Being a plain member, the heap (and the scheduler that contains it)
+        // can be prefaulted and locked at once (see qrt::prefault_and_lock).
+
+        template <typename K, typename V, std::size_t N, typename Overflow = overflow_throw>
+        class static_heap
+        {
+        public:
+            typedef K               key_type;
+            typedef V               mapped_type;
+            typedef std::pair<K,V>  value_type;
+
+        private:
+            std::array<value_type, N>   _M_cont;
+            std::size_t                 _M_size;
+
+            // compare predicate...
+            //
+            struct comp
+            {
+                bool operator()(const value_type &a, const value_type &b) const
+                {
+                    return a.first > b.first;
+                }
+            };
+
+        public:
+            static_heap()
+            : _M_cont(), _M_size()
+            {}
+
+            ~static_heap()
+            {} 
+
+            static constexpr std::size_t
+            capacity()
+            { return N; }
+
+            bool 
+            push(const key_type &key, const mapped_type &value)
+            {
+                if (_M_size == N)
+                    return Overflow::overflow();
+
+                _M_cont[_M_size++] = std::make_pair(key,value);
+                std::push_heap(_M_cont.begin(), _M_cont.begin() + _M_size, comp());
+                return true;
+            }
+
+            value_type
+            pop()
+            {
+                const value_type ret = _M_cont.front(); 
+                std::pop_heap(_M_cont.begin(), _M_cont.begin() + _M_size, comp());
+                --_M_size;
+                return ret; 
+            }
+
+            mapped_type 
+            pop_value()
+            {
+                return pop().second;
+            }
+
+            value_type &
+            top() 
+            { return _M_cont.front(); }
+
+            const value_type &
+            top() const
+            { return _M_cont.front(); }
+
+            bool
+            empty() const
+            { return _M_size == 0; } 
+
+            std::size_t
+            size() const
+            { return _M_size; }
+        };
+
+        // basic_scheduler<..., qrt::random_access::static_capacity<4096>::heap, ...>
+        //
+
+        template <std::size_t N, typename Overflow = overflow_throw>
+        struct static_capacity
+        {
+            template <typename K, typename V>
+            struct heap : public static_heap<K, V, N, Overflow> {};
+        };
+    }
+
+    // Indexed binary heap: every element knows its position in the heap by
+    // means of heap_index() (basic_thread provides it), hence an element can be 
+    // removed or moved to any key in O(log n). The key passed to erase/update
+    // is not needed (it is there for the interface of redblack::heap), the 
+    // position is checked against the value: an element of another heap is
+    // not found.
+
+    namespace indexed {
+
+        template <typename K, typename V>
+        class heap
+        {
+        public:
+            typedef K               key_type;
+            typedef V               mapped_type;
+            typedef std::pair<K,V>  value_type;
+
+            static const std::size_t npos = static_cast<std::size_t>(-1);
+
+        private:
+            std::vector<value_type> _M_cont;
+
+            void
+            _M_place(std::size_t i, const value_type &e)
+            {
+                _M_cont[i] = e;
+                e.second->heap_index() = i;
+            }
+
+            void
+            _M_sift_up(std::size_t i)
+            {
+                value_type e = _M_cont[i];
+                while (i > 0)
+                {
+                    std::size_t p = (i - 1) / 2;
+                    if (!(e.first < _M_cont[p].first))
+                        break;
+                    _M_place(i, _M_cont[p]);
+                    i = p;
+                }
+                _M_place(i, e);
+            }
+
+            void
+            _M_sift_down(std::size_t i)
+            {
+                const std::size_t n = _M_cont.size();
+                value_type e = _M_cont[i];
+                for(;;)
+                {
+                    std::size_t c = 2 * i + 1;
+                    if (c >= n)
+                        break;
+                    if (c + 1 < n && _M_cont[c+1].first < _M_cont[c].first)
+                        ++c;
+                    if (!(_M_cont[c].first < e.first))
+                        break;
+                    _M_place(i, _M_cont[c]);
+                    i = c;
+                }
+                _M_place(i, e);
+            }
+
+            // remove the element at i...
+            //
+            void
+            _M_remove(std::size_t i)
+            {
+                _M_cont[i].second->heap_index() = npos;
+
+                value_type last = _M_cont.back();
+                _M_cont.pop_back();
+                if (i == _M_cont.size())
+                    return;
+
+                _M_cont[i] = last;
+                if (i > 0 && last.first < _M_cont[(i - 1) / 2].first)
+                    _M_sift_up(i);
+                else
+                    _M_sift_down(i);
+            }
+
+            std::size_t
+            _M_position(const mapped_type &value) const
+            {
+                std::size_t i = value->heap_index();
+                return i < _M_cont.size() && _M_cont[i].second == value ? i : npos;
+            }
+
+        public:
+            heap()
+            : _M_cont()
+            {}
+
+            ~heap()
+            {} 
+
+            void 
+            push(const key_type &key, const mapped_type &value)
+            {
+                _M_cont.push_back(std::make_pair(key, value));
+                _M_sift_up(_M_cont.size() - 1);
+            }
+
+            value_type
+            pop()
+            {
+                const value_type ret = _M_cont.front(); 
+                _M_remove(0);
+                return ret; 
+            }
+
+            mapped_type 
+            pop_value()
+            {
+                return pop().second;
+            }
+
+            // push a range of value_type, with a single rebuild if cheaper...
+            //
+            template <typename Iter>
+            void
+            push_bulk(Iter first, Iter last)
+            {
+                const std::size_t n = _M_cont.size();
+                _M_cont.insert(_M_cont.end(), first, last);
+
+                if (detail::rebuild_heap(n, _M_cont.size() - n)) {
+                    for(std::size_t i = 0; i < _M_cont.size(); ++i)
+                        _M_cont[i].second->heap_index() = i;
+                    for(std::size_t i = _M_cont.size() / 2; i-- > 0; )
+                        _M_sift_down(i);
+                }
+                else
+                    for(std::size_t i = n; i < _M_cont.size(); ++i)
+                        _M_sift_up(i);
+            }
+
+            // remove an element: false if it is not in this heap...
+            //
+            bool
+            erase(const key_type &, const mapped_type &value)
+            {
+                std::size_t i = _M_position(value);
+                if (i == npos)
+                    return false;
+                _M_remove(i);
+                return true;
+            }
+
+            // move an element to a new key: false if it is not in this heap...
+            //
+            bool
+            update(const key_type &, const mapped_type &value, const key_type &new_key)
+            {
+                std::size_t i = _M_position(value);
+                if (i == npos)
+                    return false;
+                const key_type old = _M_cont[i].first;
+                _M_cont[i].first = new_key;
+                if (new_key < old)
+                    _M_sift_up(i);
+                else
+                    _M_sift_down(i);
+                return true;
+            }
+
+            bool
+            contains(const mapped_type &value) const
+            { return _M_position(value) != npos; }
+
+            value_type &
+            top() 
+            { return _M_cont.front(); }
+
+            const value_type &
+            top() const
+            { return _M_cont.front(); }
+
+            bool
+            empty() const
+            { return _M_cont.empty(); } 
+
+            std::size_t
+            size() const
+            { return _M_cont.size(); } 
+        };
     }
 
     // SGI: A heap is a particular way of ordering the elements in a range [f, l)
-    // this heap implementation is based on std::map<>. Basically it's heap
-    // implemented by means of a redblack tree. 
+    // this heap implementation is based on std::multimap<>. Basically it's heap
+    // implemented by means of a redblack tree. Elements with the same key are
+    // kept (FIFO), and can be removed or moved by key and value in O(log n).
 
     namespace redblack {
 
@@ -205,7 +555,19 @@ namespace qrt {
             typedef std::pair<K,V>  value_type;
 
         private:
-            std::map<key_type, mapped_type, std::less<K> >  _M_cont;
+            typedef std::multimap<key_type, mapped_type, std::less<K> > map_type;
+
+            map_type _M_cont;
+
+            typename map_type::iterator
+            _M_find(const key_type &key, const mapped_type &value)
+            {
+                std::pair<typename map_type::iterator, typename map_type::iterator> r = _M_cont.equal_range(key);
+                for(; r.first != r.second; ++r.first)
+                    if (r.first->second == value)
+                        return r.first;
+                return _M_cont.end();
+            }
 
         public:
             heap()
@@ -232,15 +594,38 @@ namespace qrt {
             V pop_value()
             {
                 V ret = _M_cont.begin()->second; 
-                _M_cont.erease(_M_cont.begin());
+                _M_cont.erase(_M_cont.begin());
                 return ret; 
             }
 
-            value_type &
-            top() 
-            { return * _M_cont.begin(); }
+            // remove the element pushed with key: false if not found...
+            //
+            bool
+            erase(const key_type &key, const mapped_type &value)
+            {
+                typename map_type::iterator it = _M_find(key, value);
+                if (it == _M_cont.end())
+                    return false;
+                _M_cont.erase(it);
+                return true;
+            }
 
-            const value_type &
+            // move the element pushed with key to a new key: false if not found...
+            //
+            bool
+            update(const key_type &key, const mapped_type &value, const key_type &new_key)
+            {
+                typename map_type::iterator it = _M_find(key, value);
+                if (it == _M_cont.end())
+                    return false;
+                _M_cont.erase(it);
+                _M_cont.insert(std::make_pair(new_key, value));
+                return true;
+            }
+
+            // the key of a multimap element is const...
+            //
+            value_type
             top() const
             { return * _M_cont.begin(); }
 
@@ -251,6 +636,893 @@ namespace qrt {
         };
     }
 
+    // Hierarchical timing wheel (G. Varghese, T. Lauck): keys (TSC cycles) are 
+    // hashed into Levels wheels of 2^Bits slots, the slot of level l spanning 
+    // 2^(Shift + l*Bits) cycles. Push is O(1), pop is O(1) amortized (every entry
+    // cascades at most Levels times). The entries of the current slot (and the 
+    // overdue ones) are kept in a small binary heap, so that the ordering is
+    // exact. Keys beyond the span of the wheels are parked in an overflow heap.
+
+    namespace wheel {
+
+        template <typename K, typename V, unsigned Shift, unsigned Bits, unsigned Levels>
+        class basic_timing_wheel
+        {
+            static_assert(std::is_unsigned<K>::value, "timing_wheel: unsigned key required");
+            static_assert(Bits >= 6, "timing_wheel: at least 64 slots per level");
+            static_assert(Levels > 0 && Shift + Bits * Levels < sizeof(K) * 8, "timing_wheel: too many levels");
+
+        public:
+            typedef K               key_type;
+            typedef V               mapped_type;
+            typedef std::pair<K,V>  value_type;
+
+            static const std::size_t slots = std::size_t(1) << Bits;
+            static const std::size_t words = slots / 64;
+
+        private:
+            // compare predicate...
+            //
+            struct comp
+            {
+                bool operator()(const value_type &a, const value_type &b) const
+                {
+                    return a.first > b.first;
+                }
+            };
+
+            std::vector<value_type>     _M_current;                 /* current slot (binary heap) */
+            std::vector<value_type>     _M_overflow;                /* beyond the wheels (binary heap) */
+            std::vector<value_type>     _M_slot[Levels][slots];
+            uint64_t                    _M_bitmap[Levels][words];
+
+            key_type                    _M_cursor;                  /* current tick */
+            std::size_t                 _M_size;
+
+            static key_type
+            _S_tick(const key_type &key)
+            { return key >> Shift; }
+
+            static std::size_t
+            _S_index(key_type tick, unsigned level)
+            { return static_cast<std::size_t>(tick >> (level * Bits)) & (slots-1); }
+
+            // first non-empty slot after n, or slots...
+            //
+            std::size_t
+            _M_next_slot(unsigned level, std::size_t n) const
+            {
+                for(std::size_t i = ++n; i < slots; i = (i | 63) + 1)
+                {
+                    uint64_t w = _M_bitmap[level][i >> 6] & (~uint64_t(0) << (i & 63));
+                    if (w)
+                        return (i & ~std::size_t(63)) + __builtin_ctzll(w);
+                }
+                return slots;
+            }
+
+            void
+            _M_insert(const value_type &e)
+            {
+                const key_type tick = _S_tick(e.first);
+
+                if (tick <= _M_cursor) {
+                    _M_current.push_back(e);
+                    std::push_heap(_M_current.begin(), _M_current.end(), comp());
+                    return;
+                }
+
+                // the lowest level where tick and cursor share the upper bits...
+
+                const key_type diff = tick ^ _M_cursor;
+                for(unsigned l = 0; l < Levels; ++l)
+                {
+                    if ((diff >> ((l+1) * Bits)) == 0) {
+                        std::size_t n = _S_index(tick, l);
+                        _M_slot[l][n].push_back(e);
+                        _M_bitmap[l][n >> 6] |= uint64_t(1) << (n & 63);
+                        return;
+                    }
+                }
+
+                _M_overflow.push_back(e);
+                std::push_heap(_M_overflow.begin(), _M_overflow.end(), comp());
+            }
+
+            // advance the cursor to the next non-empty slot and fill the current heap...
+            //
+            void
+            _M_advance()
+            {
+                while (_M_current.empty())
+                {
+                    unsigned l = 0;
+                    std::size_t n = slots;
+
+                    for(; l < Levels; ++l)
+                        if ((n = _M_next_slot(l, _S_index(_M_cursor, l))) != slots)
+                            break;
+
+                    if (l == Levels) {
+
+                        // the wheels are empty: move on to the overflow...
+
+                        _M_cursor = _S_tick(_M_overflow.front().first);
+                        while (!_M_overflow.empty() && 
+                               ((_S_tick(_M_overflow.front().first) ^ _M_cursor) >> (Levels * Bits)) == 0)
+                        {
+                            _M_insert(_M_overflow.front());
+                            std::pop_heap(_M_overflow.begin(), _M_overflow.end(), comp());
+                            _M_overflow.pop_back();
+                        }
+                        continue;
+                    }
+
+                    // move the cursor to the beginning of the slot and cascade its entries...
+
+                    const unsigned shift = (l+1) * Bits;
+                    _M_cursor = ((_M_cursor >> shift) << shift) | (static_cast<key_type>(n) << (l * Bits));
+
+                    _M_bitmap[l][n >> 6] &= ~(uint64_t(1) << (n & 63));
+
+                    std::vector<value_type> &slot = _M_slot[l][n];
+                    for(typename std::vector<value_type>::const_iterator it = slot.begin(); it != slot.end(); ++it)
+                        _M_insert(*it);
+                    slot.clear();
+                }
+            }
+
+        public:
+            basic_timing_wheel()
+            : _M_current(), _M_overflow(), _M_cursor(), _M_size()
+            {
+                std::memset(_M_bitmap, 0, sizeof(_M_bitmap));
+            }
+
+            ~basic_timing_wheel()
+            {} 
+
+            void 
+            push(const key_type &key, const mapped_type &value)
+            {
+                if (_M_size++ == 0)
+                    _M_cursor = _S_tick(key);
+                _M_insert(std::make_pair(key,value));
+            }
+
+            value_type
+            pop()
+            {
+                const value_type ret = _M_current.front(); 
+                std::pop_heap(_M_current.begin(), _M_current.end(), comp());
+                _M_current.pop_back();   
+                if (--_M_size)
+                    _M_advance();
+                return ret; 
+            }
+
+            mapped_type 
+            pop_value()
+            {
+                return pop().second;
+            }
+
+            value_type &
+            top() 
+            { return _M_current.front(); }
+
+            const value_type &
+            top() const
+            { return _M_current.front(); }
+
+            bool
+            empty() const
+            { return _M_size == 0; } 
+
+            std::size_t
+            size() const
+            { return _M_size; }
+        };
+
+        // default: 1024 cycles per tick, 4 levels of 256 slots (2^42 cycles)...
+        //
+
+        template <typename K, typename V>
+        struct timing_wheel : public basic_timing_wheel<K, V, 10, 8, 4> {};
+
+        // custom geometry: basic_scheduler<..., qrt::wheel::config<8,8,3>::timing_wheel, ...>
+        //
+
+        template <unsigned Shift, unsigned Bits, unsigned Levels>
+        struct config
+        {
+            template <typename K, typename V>
+            struct timing_wheel : public basic_timing_wheel<K, V, Shift, Bits, Levels> {};
+        };
+    }
+
+    // d-ary heap with the keys kept apart from the values (structure of arrays).
+    // Node i is stored at position i + D - 1 of a cache-line aligned key array,
+    // hence the D children of a node always lie in the same cache line (8 x 64-bit 
+    // or 16 x 32-bit keys) and the minimum is selected with SIMD compares where
+    // available (SSE4.1 for 32-bit keys, AVX-512 for 64-bit keys).
+    //
+    // Compact heaps store the keys as 32-bit offsets from an epoch that lags the
+    // earliest deadline by 2^30 cycles. Keys further than 2^32 cycles saturate:
+    // the heap is rebased (O(n)) when the top gets beyond 2^31 cycles from the
+    // epoch, or when a key earlier than the epoch is pushed. Both are rare, as
+    // the epoch moves by at least 2^30 cycles each time.
+
+    namespace detail {
+
+        template <typename Tp, std::size_t Align>
+        struct aligned_allocator
+        {
+            typedef Tp value_type;
+
+            template <typename U>
+            struct rebind { typedef aligned_allocator<U, Align> other; };
+
+            aligned_allocator()
+            {}
+
+            template <typename U>
+            aligned_allocator(const aligned_allocator<U, Align> &)
+            {}
+
+            Tp *
+            allocate(std::size_t n)
+            {
+                void * p;
+                if (::posix_memalign(&p, Align, n * sizeof(Tp)) != 0)
+                    throw std::bad_alloc();
+                return static_cast<Tp *>(p);
+            }
+
+            void
+            deallocate(Tp *p, std::size_t)
+            { ::free(p); }
+
+            template <typename U>
+            bool operator==(const aligned_allocator<U, Align> &) const
+            { return true; }
+
+            template <typename U>
+            bool operator!=(const aligned_allocator<U, Align> &) const
+            { return false; }
+        };
+
+        // index of the minimum among D keys (the first one, in case of ties)...
+        //
+
+        template <unsigned Bits, unsigned D>
+        struct simd_min
+        {
+            static const bool enabled = false;
+            static unsigned find(const void *) { return 0; }
+        };
+
+#ifdef __SSE4_1__
+        template <unsigned D>
+        struct simd_min<32, D>
+        {
+            static const bool enabled = (D == 4 || D == 8 || D == 16);
+
+            static unsigned 
+            find(const void *p)
+            {
+                const __m128i * v = static_cast<const __m128i *>(p);
+                __m128i m = _mm_load_si128(v);
+                for(unsigned i = 1; i < D/4; ++i)
+                    m = _mm_min_epu32(m, _mm_load_si128(v+i));
+                m = _mm_min_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1,0,3,2)));
+                m = _mm_min_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2,3,0,1)));
+
+                unsigned mask = 0;
+                for(unsigned i = 0; i < D/4; ++i)
+                    mask |= static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_load_si128(v+i), m)))) << (i*4);
+                return __builtin_ctz(mask);
+            }
+        };
+#endif
+
+#ifdef __AVX512F__
+        template <>
+        struct simd_min<64, 8>
+        {
+            static const bool enabled = true;
+
+            static unsigned 
+            find(const void *p)
+            {
+                __m512i v = _mm512_load_si512(p);
+                __m512i m = _mm512_maskz_min_epu64(0xff, v, _mm512_maskz_shuffle_i64x2(0xff, v, v, _MM_SHUFFLE(1,0,3,2)));
+                m = _mm512_maskz_min_epu64(0xff, m, _mm512_maskz_shuffle_i64x2(0xff, m, m, _MM_SHUFFLE(2,3,0,1)));
+                m = _mm512_maskz_min_epu64(0xff, m, _mm512_maskz_shuffle_epi32(0xffff, m, _MM_PERM_BADC));
+                return __builtin_ctz(_mm512_cmpeq_epu64_mask(v, m));
+            }
+        };
+#endif
+    }
+
+    namespace dary {
+
+        template <typename K, typename V, unsigned D, bool Compact>
+        class basic_heap
+        {
+            static_assert(std::is_unsigned<K>::value, "dary::heap: unsigned key required");
+            static_assert(D >= 2 && (D & (D-1)) == 0, "dary::heap: arity must be a power of 2");
+
+        public:
+            typedef K               key_type;
+            typedef V               mapped_type;
+            typedef std::pair<K,V>  value_type;
+
+            typedef typename std::conditional<Compact, uint32_t, K>::type stored_type;
+
+        private:
+            static stored_type 
+            _S_max()                                    /* empty slot */
+            { return static_cast<stored_type>(~stored_type(0)); }
+
+            static key_type
+            _S_margin()
+            { return Compact ? (key_type(1) << 30) : 0; }
+
+            std::vector<stored_type, detail::aligned_allocator<stored_type, cacheline_size> > _M_key;
+            std::vector<value_type>     _M_data;
+            key_type                    _M_epoch;
+
+            stored_type
+            _M_encode(const key_type &key) const
+            {
+                if (!Compact)
+                    return static_cast<stored_type>(key);
+                if (key < _M_epoch)
+                    return 0;
+                const key_type off = key - _M_epoch;
+                return off < _S_max() ? static_cast<stored_type>(off) : _S_max() - 1;
+            }
+
+            static std::size_t
+            _S_pos(std::size_t n)
+            { return n + D - 1; }
+
+            static unsigned
+            _S_min_child(const stored_type *p)
+            {
+                if (detail::simd_min<sizeof(stored_type) * 8, D>::enabled)
+                    return detail::simd_min<sizeof(stored_type) * 8, D>::find(p);
+
+                unsigned r = 0;
+                for(unsigned i = 1; i < D; ++i)
+                    if (p[i] < p[r])
+                        r = i;
+                return r;
+            }
+
+            void
+            _M_sift_up(std::size_t n, stored_type k, const value_type &e)
+            {
+                while (n > 0)
+                {
+                    std::size_t parent = (n-1)/D;
+                    if (!(k < _M_key[_S_pos(parent)]))
+                        break;
+                    _M_key[_S_pos(n)] = _M_key[_S_pos(parent)];
+                    _M_data[n] = _M_data[parent];
+                    n = parent;
+                }
+                _M_key[_S_pos(n)] = k;
+                _M_data[n] = e;
+            }
+
+            void
+            _M_sift_down(std::size_t n, stored_type k, const value_type &e)
+            {
+                const std::size_t size = _M_data.size();
+                for(;;)
+                {
+                    std::size_t c = D * n + 1;
+                    if (c >= size)
+                        break;
+                    c += _S_min_child(&_M_key[_S_pos(c)]);
+                    if (!(_M_key[_S_pos(c)] < k))
+                        break;
+                    _M_key[_S_pos(n)] = _M_key[_S_pos(c)];
+                    _M_data[n] = _M_data[c];
+                    n = c;
+                }
+                _M_key[_S_pos(n)] = k;
+                _M_data[n] = e;
+            }
+
+            // move the epoch close to the earliest deadline and rebuild the heap...
+            //
+            void
+            _M_rebase()
+            {
+                key_type m = _M_data[0].first;
+                for(std::size_t i = 1; i < _M_data.size(); ++i)
+                    m = std::min(m, _M_data[i].first);
+
+                _M_epoch = m > _S_margin() ? m - _S_margin() : 0;
+
+                for(std::size_t i = 0; i < _M_data.size(); ++i)
+                    _M_key[_S_pos(i)] = _M_encode(_M_data[i].first);
+
+                for(std::size_t i = _M_data.size() / D + 1; i-- > 0; )
+                    if (i < _M_data.size())
+                        _M_sift_down(i, _M_key[_S_pos(i)], value_type(_M_data[i]));
+            }
+
+        public:
+            basic_heap()
+            : _M_key(2 * D, _S_max()), _M_data(), _M_epoch()
+            {}
+
+            ~basic_heap()
+            {} 
+
+            void 
+            push(const key_type &key, const mapped_type &value)
+            {
+                if (Compact && _M_data.empty())
+                    _M_epoch = key > _S_margin() ? key - _S_margin() : 0;
+
+                if (_M_key.size() < _M_data.size() + 1 + 2 * D)
+                    _M_key.resize(_M_key.size() * 2, _S_max());
+
+                const value_type e(key, value);
+                _M_data.push_back(e);
+                _M_sift_up(_M_data.size()-1, _M_encode(key), e);
+
+                if (Compact && key < _M_epoch)
+                    _M_rebase();
+            }
+
+            value_type
+            pop()
+            {
+                const value_type ret = _M_data.front(); 
+                const std::size_t last = _M_data.size()-1;
+
+                const stored_type k = _M_key[_S_pos(last)];
+                const value_type  e = _M_data[last];
+                _M_key[_S_pos(last)] = _S_max();
+                _M_data.pop_back();
+
+                if (last) {
+                    _M_sift_down(0, k, e);
+                    if (Compact && _M_key[_S_pos(0)] >= (stored_type(1) << 31))
+                        _M_rebase();
+                }
+                return ret; 
+            }
+
+            mapped_type 
+            pop_value()
+            {
+                return pop().second;
+            }
+
+            value_type &
+            top() 
+            { return _M_data.front(); }
+
+            const value_type &
+            top() const
+            { return _M_data.front(); }
+
+            bool
+            empty() const
+            { return _M_data.empty(); } 
+
+            std::size_t
+            size() const
+            { return _M_data.size(); }
+        };
+
+        // 8-ary heap, 64-bit keys (one cache line per children set)...
+
+        template <typename K, typename V>
+        struct heap : public basic_heap<K, V, 8, false> {};
+
+        // 16-ary heap, 32-bit keys relative to an epoch (one cache line per children set)...
+
+        template <typename K, typename V>
+        struct compact_heap : public basic_heap<K, V, 16, true> {};
+
+        // custom arity: basic_scheduler<..., qrt::dary::config<4,false>::heap, ...>
+        //
+
+        template <unsigned D, bool Compact>
+        struct config
+        {
+            template <typename K, typename V>
+            struct heap : public basic_heap<K, V, D, Compact> {};
+        };
+    }
+
+    // Intrusive pairing heap (M.L. Fredman, R. Sedgewick, D.D. Sleator, R.E. Tarjan):
+    // the links live in the elements themselves, thus neither push nor pop ever 
+    // allocate or copy. V is a pointer to a type that exposes its hook by means 
+    // of pairing() (basic_thread does). push, top and decrease_key are O(1), pop 
+    // is O(log n) amortized (two-pass pairing).
+
+    namespace intrusive {
+
+        template <typename K, typename V>
+        struct pairing_hook
+        {
+            K   key;
+            V   child;      /* leftmost child */
+            V   sibling;    /* right sibling */
+            V   prev;       /* left sibling, or parent for the leftmost child */
+
+            pairing_hook()
+            : key(), child(), sibling(), prev()
+            {}
+        };
+
+        template <typename K, typename V>
+        class pairing_heap
+        {
+        public:
+            typedef K               key_type;
+            typedef V               mapped_type;
+            typedef std::pair<K,V>  value_type;
+
+        private:
+            V           _M_root;
+            value_type  _M_top;
+
+            static V
+            _S_meld(V a, V b)
+            {
+                if (b->pairing().key < a->pairing().key)
+                    std::swap(a,b);
+
+                // b becomes the leftmost child of a...
+
+                b->pairing().sibling = a->pairing().child;
+                if (a->pairing().child)
+                    a->pairing().child->pairing().prev = b;
+                b->pairing().prev = a;
+                a->pairing().child = b;
+                return a;
+            }
+
+            // two-pass pairing of a list of siblings...
+            //
+            static V
+            _S_merge_pairs(V first)
+            {
+                if (!first)
+                    return V();
+
+                V stack = V();
+
+                // left to right: meld pairs, pushing the roots on a stack (linked by sibling)...
+
+                while (first)
+                {
+                    V a = first, b = a->pairing().sibling;
+                    first = b ? b->pairing().sibling : V();
+
+                    a->pairing().sibling = a->pairing().prev = V();
+                    if (b) {
+                        b->pairing().sibling = b->pairing().prev = V();
+                        a = _S_meld(a, b);
+                    }
+                    a->pairing().sibling = stack;
+                    stack = a;
+                }
+
+                // right to left: meld the roots...
+
+                V r = stack;
+                stack = r->pairing().sibling;
+                r->pairing().sibling = V();
+                while (stack)
+                {
+                    V n = stack;
+                    stack = n->pairing().sibling;
+                    n->pairing().sibling = V();
+                    r = _S_meld(r, n);
+                }
+                return r;
+            }
+
+            void
+            _M_set_root(V r)
+            {
+                _M_root = r;
+                if (r)
+                    _M_top = value_type(r->pairing().key, r);
+            }
+
+        public:
+            pairing_heap()
+            : _M_root(), _M_top()
+            {}
+
+            ~pairing_heap()
+            {} 
+
+            void 
+            push(const key_type &key, const mapped_type &value)
+            {
+                pairing_hook<K,V> &h = value->pairing();
+                h.key = key;
+                h.child = h.sibling = h.prev = V();
+                _M_set_root(_M_root ? _S_meld(_M_root, value) : value);
+            }
+
+            value_type
+            pop()
+            {
+                const value_type ret = _M_top; 
+                _M_set_root(_S_merge_pairs(_M_root->pairing().child));
+                return ret; 
+            }
+
+            mapped_type 
+            pop_value()
+            {
+                return pop().second;
+            }
+
+            // move an element (already in the heap) to an earlier key...
+            //
+            void
+            decrease_key(const mapped_type &value, const key_type &key)
+            {
+                pairing_hook<K,V> &h = value->pairing();
+                h.key = key;
+
+                if (value != _M_root) {
+
+                    // cut the subtree off...
+
+                    if (h.prev->pairing().child == value)
+                        h.prev->pairing().child = h.sibling;
+                    else
+                        h.prev->pairing().sibling = h.sibling;
+                    if (h.sibling)
+                        h.sibling->pairing().prev = h.prev;
+                    h.sibling = h.prev = V();
+
+                    _M_root = _S_meld(_M_root, value);
+                }
+                _M_set_root(_M_root);
+            }
+
+            value_type &
+            top() 
+            { return _M_top; }
+
+            const value_type &
+            top() const
+            { return _M_top; }
+
+            bool
+            empty() const
+            { return !_M_root; } 
+        };
+    }
+
+    // fixed-priority policy: among the released threads (key <= now) the one 
+    // with the highest priority is dispatched first (0 is the highest, up to 
+    // 64 levels, FIFO within a level), regardless of the deadlines. When no 
+    // thread is released yet, the earliest release is returned.
+    //
+    // The threads are kept in a release heap until due, then moved to the FIFO
+    // of their level; a bitmap of the non-empty levels gives the highest ready
+    // level in O(1) (find-first-set). The value must provide priority() (as
+    // basic_thread does), and the Clock tells the current time.
+
+    namespace priority {
+
+        template <typename K, typename V, typename Clock>
+        class basic_heap
+        {
+        public:
+            typedef K               key_type;
+            typedef V               mapped_type;
+            typedef std::pair<K,V>  value_type;
+
+            static const unsigned int levels = 64;
+
+        private:
+            random_access::vector_heap<K, V>    _M_release;
+            std::deque<value_type>              _M_ready[levels];
+            uint64_t                            _M_bitmap;
+            K                                   _M_early;   /* release instant of the ready threads, if not released yet */
+            bool                                _M_is_early;
+
+            static unsigned int
+            _S_level(const V &v)
+            {
+                int p = v->priority();
+                return p < 0 ? 0 : p >= static_cast<int>(levels) ? levels - 1 : static_cast<unsigned int>(p);
+            }
+
+            // move the threads released by t into the ready queues...
+            //
+            void
+            _M_promote(const K &t)
+            {
+                while (!_M_release.empty() && _M_release.top().first <= t)
+                {
+                    value_type e = _M_release.pop();
+                    unsigned int l = _S_level(e.second);
+                    _M_ready[l].push_back(e);
+                    _M_bitmap |= uint64_t(1) << l;
+                }
+            }
+
+            // the released threads or, if none, the ones released next, all
+            // of them: threads released at the same instant go by priority. 
+            // The latter are not released yet: push() moves them back if an 
+            // earlier thread comes in...
+            //
+            void
+            _M_promote()
+            {
+                if (_M_release.empty() && !_M_is_early)
+                    return;
+
+                const K now = Clock::get_cycles();
+                _M_promote(now);
+                if (_M_is_early && _M_early <= now)
+                    _M_is_early = false;
+
+                if (!_M_bitmap && !_M_release.empty()) {
+                    _M_early = _M_release.top().first;
+                    _M_is_early = true;
+                    _M_promote(_M_early);
+                }
+            }
+
+            void
+            _M_unpromote()
+            {
+                for(; _M_bitmap; _M_bitmap &= _M_bitmap - 1)
+                {
+                    std::deque<value_type> &q = _M_ready[__builtin_ctzll(_M_bitmap)];
+                    for(const value_type &e : q)
+                        _M_release.push(e.first, e.second);
+                    q.clear();
+                }
+                _M_is_early = false;
+            }
+
+        public:
+            basic_heap()
+            : _M_release(), _M_ready(), _M_bitmap(0), _M_early(), _M_is_early(false)
+            {}
+
+            void 
+            push(const key_type &key, const mapped_type &value)
+            {
+                if (_M_is_early && key < _M_early)
+                    _M_unpromote();
+                _M_release.push(key, value);
+            }
+
+            value_type
+            pop()
+            {
+                _M_promote();
+
+                const unsigned int l = static_cast<unsigned int>(__builtin_ctzll(_M_bitmap));
+                value_type ret = _M_ready[l].front();
+                _M_ready[l].pop_front();
+                if (_M_ready[l].empty())
+                    _M_bitmap &= ~(uint64_t(1) << l);
+                if (!_M_bitmap)
+                    _M_is_early = false;
+                return ret;
+            }
+
+            mapped_type 
+            pop_value()
+            {
+                return pop().second;
+            }
+
+            value_type &
+            top() 
+            {
+                _M_promote();
+
+                return _M_ready[__builtin_ctzll(_M_bitmap)].front();
+            }
+
+            bool
+            empty() const
+            { return !_M_bitmap && _M_release.empty(); } 
+        };
+
+        // template alias is not available...
+        //
+
+        template <typename Clock>
+        struct config
+        {
+            template <typename K, typename V>
+            struct heap : public basic_heap<K, V, Clock> {};
+        };
+    }
+
+    namespace detail {
+
+        // push, false if a bounded heap rejected the element (static_heap with
+        // any overflow policy: the length_error of overflow_throw is caught 
+        // here, so that the scheduler can retire the thread), true for the 
+        // unbounded ones...
+        //
+        template <typename Heap, typename K, typename V>
+        inline auto 
+        heap_push(Heap &h, const K &key, const V &value, int) 
+            -> typename std::enable_if<std::is_same<decltype(h.push(key, value)), bool>::value, bool>::type
+        {
+            try 
+            {
+                return h.push(key, value);
+            }
+            catch(std::length_error &)
+            {
+                return false;
+            }
+        }
+
+        template <typename Heap, typename K, typename V>
+        inline bool
+        heap_push(Heap &h, const K &key, const V &value, long)
+        {
+            h.push(key, value);
+            return true;
+        }
+
+        template <typename Heap, typename K, typename V>
+        inline bool
+        heap_push(Heap &h, const K &key, const V &value)
+        {
+            return heap_push(h, key, value, 0);
+        }
+
+        // push_bulk if the heap policy provides it, one push at a time otherwise.
+        // Return the first element rejected (last if none): a bounded heap is 
+        // full from there on...
+        //
+        template <typename Heap, typename Iter>
+        inline auto 
+        heap_push_bulk(Heap &h, Iter first, Iter last, int) -> decltype(h.push_bulk(first, last), Iter())
+        {
+            h.push_bulk(first, last);
+            return last;
+        }
+
+        template <typename Heap, typename Iter>
+        inline Iter
+        heap_push_bulk(Heap &h, Iter first, Iter last, long)
+        {
+            for(; first != last; ++first)
+                if (!heap_push(h, first->first, first->second))
+                    break;
+            return first;
+        }
+
+        template <typename Heap, typename Iter>
+        inline Iter
+        heap_push_bulk(Heap &h, Iter first, Iter last)
+        {
+            return heap_push_bulk(h, first, last, 0);
+        }
+    }
+
 } // namespace qrt
 
 #endif /* _QRT_HEAP_HPP_ */
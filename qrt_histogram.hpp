@@ -0,0 +1,176 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _QRT_HISTOGRAM_HPP_
+#define _QRT_HISTOGRAM_HPP_
+
+#include <iostream>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace qrt {
+
+    ///////////////////// basic_histogram
+    //
+    // log-linear histogram (HdrHistogram-like) of non-negative integers, with
+    // fixed memory and no allocation: values below 2^SubBits are counted exactly,
+    // above that every power of 2 is split into 2^SubBits linear buckets, hence
+    // the relative error of a quantile is below 2^-SubBits (3% by default).
+    // Values above 2^MaxBits are clamped to the last bucket (max() stays exact).
+    //
+    // record() is a clz, a shift and a few adds. Histograms with the same 
+    // geometry are merged by summing the buckets (e.g. across schedulers).
+
+    template <unsigned int SubBits = 5, unsigned int MaxBits = 40>
+    class basic_histogram
+    {
+        static_assert(SubBits > 0 && SubBits < MaxBits && MaxBits < 64, "basic_histogram: bad geometry");
+
+    public:
+        static const std::size_t sub_buckets = std::size_t(1) << SubBits;
+        static const std::size_t buckets     = (MaxBits - SubBits + 2) * sub_buckets;
+
+    private:
+        uint64_t _M_bucket[buckets];
+        uint64_t _M_count;
+        uint64_t _M_sum;
+        uint64_t _M_min;
+        uint64_t _M_max;
+
+        static std::size_t
+        _S_index(uint64_t v)
+        {
+            if (v < sub_buckets)
+                return static_cast<std::size_t>(v);
+
+            const unsigned int msb = 63 - static_cast<unsigned int>(__builtin_clzll(v));
+            if (msb > MaxBits)
+                return buckets - 1;
+
+            const unsigned int e = msb - SubBits + 1;
+            return (std::size_t(e) << SubBits) + static_cast<std::size_t>((v >> (e-1)) - sub_buckets);
+        }
+
+        // highest value counted by the bucket...
+        //
+
+        static uint64_t
+        _S_value(std::size_t idx)
+        {
+            if (idx < sub_buckets)
+                return idx;
+
+            const unsigned int e = static_cast<unsigned int>(idx >> SubBits);
+            const uint64_t m = (idx & (sub_buckets-1)) + sub_buckets;
+            return ((m + 1) << (e-1)) - 1;
+        }
+
+    public:
+        basic_histogram()
+        : _M_bucket(), _M_count(0), _M_sum(0), _M_min(~uint64_t()), _M_max(0)
+        {}
+
+        void
+        record(uint64_t v)
+        {
+            _M_bucket[_S_index(v)]++;
+            _M_count++;
+            _M_sum += v;
+            _M_min = std::min(_M_min, v);
+            _M_max = std::max(_M_max, v);
+        }
+
+        void
+        merge(const basic_histogram &rhs)
+        {
+            for(std::size_t i = 0; i < buckets; ++i)
+                _M_bucket[i] += rhs._M_bucket[i];
+            _M_count += rhs._M_count;
+            _M_sum   += rhs._M_sum;
+            _M_min    = std::min(_M_min, rhs._M_min);
+            _M_max    = std::max(_M_max, rhs._M_max);
+        }
+
+        void
+        reset()
+        { *this = basic_histogram(); }
+
+        uint64_t
+        count() const
+        { return _M_count; }
+
+        uint64_t
+        min() const
+        { return _M_count ? _M_min : 0; }
+
+        uint64_t
+        max() const
+        { return _M_max; }
+
+        uint64_t
+        mean() const
+        { return _M_count ? _M_sum / _M_count : 0; }
+
+        // the value below which falls the fraction q (0..1) of the samples 
+        // (upper bound of its bucket, never above max)...
+        //
+
+        uint64_t
+        quantile(double q) const
+        {
+            if (!_M_count)
+                return 0;
+
+            uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(_M_count) + 0.5);
+            rank = std::max<uint64_t>(1, std::min(rank, _M_count));
+
+            uint64_t acc = 0;
+            for(std::size_t i = 0; i < buckets; ++i)
+            {
+                acc += _M_bucket[i];
+                if (acc >= rank)
+                    return i == buckets-1 ? _M_max : std::min(_S_value(i), _M_max);
+            }
+            return _M_max;
+        }
+
+        uint64_t
+        percentile(double p) const
+        { return quantile(p / 100.0); }
+    };
+
+    template <unsigned int S, unsigned int M>
+    std::ostream &
+    operator<<(std::ostream &out, const basic_histogram<S,M> &h)
+    {
+        return out << "{n:" << h.count() << " min:" << h.min() << " p50:" << h.percentile(50) 
+                   << " p99:" << h.percentile(99) << " p99.9:" << h.percentile(99.9) 
+                   << " p99.99:" << h.percentile(99.99) << " max:" << h.max() << "}";
+    }
+
+    typedef basic_histogram<> histogram;
+
+} // namespace qrt
+
+#endif /* _QRT_HISTOGRAM_HPP_ */
@@ -0,0 +1,613 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _QRT_LOCKFREE_HPP_
+#define _QRT_LOCKFREE_HPP_
+
+#include <qrt_utils.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace qrt {
+
+    // Chase-Lev work-stealing deque (fixed capacity), as formalized in:
+    // N.M. Le, A. Pop, A. Cohen, F. Zappa Nardelli, "Correct and Efficient
+    // Work-Stealing for Weak Memory Models", PPoPP 2013.
+    //
+    // The owner pushes and pops at the bottom, thieves steal from the top.
+    // Elements are pointers: a failed steal never observes a torn value.
+
+    template <typename Tp, std::size_t N = 1024>
+    class work_stealing_deque
+    {
+        static_assert((N & (N-1)) == 0, "work_stealing_deque: capacity must be a power of 2");
+
+    public:
+        typedef Tp *    value_type;
+
+    private:
+        // thieves and owner work on different cache lines...
+
+        std::atomic<long>   _M_top;
+        char                _M_pad0[cacheline_size - sizeof(std::atomic<long>)];
+        std::atomic<long>   _M_bottom;
+        char                _M_pad1[cacheline_size - sizeof(std::atomic<long>)];
+        std::atomic<Tp *>   _M_buffer[N];
+
+    public:
+        work_stealing_deque()
+        : _M_top(0), _M_pad0(), _M_bottom(0), _M_pad1()
+        {
+            for(std::size_t i = 0; i < N; ++i)
+                _M_buffer[i].store(0, std::memory_order_relaxed);
+        }
+
+        work_stealing_deque(const work_stealing_deque &) = delete;
+        work_stealing_deque& operator=(const work_stealing_deque &) = delete;
+
+        // owner side...
+        //
+
+        bool
+        push(Tp *value)
+        {
+            long b = _M_bottom.load(std::memory_order_relaxed);
+            long t = _M_top.load(std::memory_order_acquire);
+            if (b - t >= static_cast<long>(N))
+                return false;
+
+            _M_buffer[b & (N-1)].store(value, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            _M_bottom.store(b+1, std::memory_order_relaxed);
+            return true;
+        }
+
+        Tp *
+        pop()
+        {
+            long b = _M_bottom.load(std::memory_order_relaxed) - 1;
+            _M_bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long t = _M_top.load(std::memory_order_relaxed);
+
+            if (t > b) {    // empty
+                _M_bottom.store(b+1, std::memory_order_relaxed);
+                return 0;
+            }
+
+            Tp * ret = _M_buffer[b & (N-1)].load(std::memory_order_relaxed);
+            if (t == b) {   // last element: race against thieves
+                if (!_M_top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    ret = 0;
+                _M_bottom.store(b+1, std::memory_order_relaxed);
+            }
+            return ret;
+        }
+
+        // thief side...
+        //
+
+        Tp *
+        steal()
+        {
+            long t = _M_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long b = _M_bottom.load(std::memory_order_acquire);
+            if (t >= b)
+                return 0;
+
+            Tp * ret = _M_buffer[t & (N-1)].load(std::memory_order_relaxed);
+            if (!_M_top.compare_exchange_strong(t, t+1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return 0;
+            return ret;
+        }
+
+        // approximate, when called concurrently...
+        //
+
+        bool
+        empty() const
+        {
+            return _M_bottom.load(std::memory_order_relaxed) <= _M_top.load(std::memory_order_relaxed);
+        }
+
+        std::size_t
+        size() const
+        {
+            long s = _M_bottom.load(std::memory_order_relaxed) - _M_top.load(std::memory_order_relaxed);
+            return s > 0 ? static_cast<std::size_t>(s) : 0;
+        }
+
+        static constexpr std::size_t
+        capacity()
+        { return N; }
+    };
+
+    // Intrusive multi-producer/single-consumer queue (D. Vyukov).
+    //
+    // push() is wait-free (one atomic exchange) and never allocates: the
+    // link lives in the element itself (mpsc_hook). pop() is run by a single
+    // consumer and may transiently return 0 while a producer is halfway
+    // through a push: the element is then returned by a later pop().
+
+    template <typename Tp>
+    struct mpsc_hook
+    {
+        std::atomic<mpsc_hook *>    _M_next;
+        Tp *                        _M_value;
+
+        explicit mpsc_hook(Tp *value = 0)
+        : _M_next(0), _M_value(value)
+        {}
+
+        mpsc_hook(const mpsc_hook &) = delete;
+        mpsc_hook& operator=(const mpsc_hook &) = delete;
+    };
+
+    template <typename Tp>
+    class mpsc_queue
+    {
+    public:
+        typedef mpsc_hook<Tp>   hook_type;
+
+    private:
+        std::atomic<hook_type *>    _M_head;    /* producers */
+        char                        _M_pad0[cacheline_size - sizeof(std::atomic<hook_type *>)];
+        hook_type *                 _M_tail;    /* consumer */
+        hook_type                   _M_stub;
+
+    public:
+        mpsc_queue()
+        : _M_head(&_M_stub), _M_pad0(), _M_tail(&_M_stub), _M_stub()
+        {}
+
+        mpsc_queue(const mpsc_queue &) = delete;
+        mpsc_queue& operator=(const mpsc_queue &) = delete;
+
+        // producers side...
+        //
+
+        void
+        push(hook_type *h)
+        {
+            h->_M_next.store(0, std::memory_order_relaxed);
+            hook_type * prev = _M_head.exchange(h, std::memory_order_acq_rel);
+            prev->_M_next.store(h, std::memory_order_release);
+        }
+
+        // consumer side...
+        //
+
+        Tp *
+        pop()
+        {
+            hook_type * tail = _M_tail;
+            hook_type * next = tail->_M_next.load(std::memory_order_acquire);
+
+            if (tail == &_M_stub) {
+                if (!next)
+                    return 0;
+                _M_tail = tail = next;
+                next = next->_M_next.load(std::memory_order_acquire);
+            }
+
+            if (next) {
+                _M_tail = next;
+                return tail->_M_value;
+            }
+
+            if (tail != _M_head.load(std::memory_order_acquire))
+                return 0;   // a producer is in progress
+
+            push(&_M_stub);
+
+            next = tail->_M_next.load(std::memory_order_acquire);
+            if (next) {
+                _M_tail = next;
+                return tail->_M_value;
+            }
+            return 0;
+        }
+
+        // approximate, when called concurrently...
+        //
+
+        bool
+        empty() const
+        {
+            return _M_head.load(std::memory_order_relaxed) == _M_tail &&
+                   _M_tail == &_M_stub;
+        }
+    };
+
+    // Bounded single-producer/single-consumer ring (Lamport), with the indices
+    // on separate cache lines and a local copy of the opposite index on each
+    // side, so that the shared lines are touched only when the cached view is
+    // exhausted. push_n/pop_n publish and consume a whole batch with a single 
+    // release store.
+
+    template <typename Tp, std::size_t N = 1024>
+    class spsc_ring
+    {
+        static_assert((N & (N-1)) == 0, "spsc_ring: capacity must be a power of 2");
+
+    public:
+        typedef Tp  value_type;
+
+    private:
+        std::atomic<std::size_t>    _M_head;        /* consumer */
+        std::size_t                 _M_tail_cache;
+        char                        _M_pad0[cacheline_size - sizeof(std::atomic<std::size_t>) - sizeof(std::size_t)];
+        std::atomic<std::size_t>    _M_tail;        /* producer */
+        std::size_t                 _M_head_cache;
+        char                        _M_pad1[cacheline_size - sizeof(std::atomic<std::size_t>) - sizeof(std::size_t)];
+        Tp                          _M_buffer[N];
+
+    public:
+        spsc_ring()
+        : _M_head(0), _M_tail_cache(0), _M_pad0(), _M_tail(0), _M_head_cache(0), _M_pad1(), _M_buffer()
+        {}
+
+        spsc_ring(const spsc_ring &) = delete;
+        spsc_ring& operator=(const spsc_ring &) = delete;
+
+        // producer side: push up to n values, return the number pushed...
+        //
+
+        std::size_t
+        push_n(const Tp *value, std::size_t n)
+        {
+            std::size_t tail = _M_tail.load(std::memory_order_relaxed);
+
+            if (N - (tail - _M_head_cache) < n)
+                _M_head_cache = _M_head.load(std::memory_order_acquire);
+
+            n = std::min(n, N - (tail - _M_head_cache));
+            for(std::size_t i = 0; i < n; ++i)
+                _M_buffer[(tail + i) & (N-1)] = value[i];
+
+            if (n)
+                _M_tail.store(tail + n, std::memory_order_release);
+            return n;
+        }
+
+        bool
+        push(const Tp &value)
+        { return push_n(&value, 1) == 1; }
+
+        // consumer side: pop up to n values, return the number popped...
+        //
+
+        std::size_t
+        pop_n(Tp *value, std::size_t n)
+        {
+            std::size_t head = _M_head.load(std::memory_order_relaxed);
+
+            if (_M_tail_cache - head < n)
+                _M_tail_cache = _M_tail.load(std::memory_order_acquire);
+
+            n = std::min(n, _M_tail_cache - head);
+            for(std::size_t i = 0; i < n; ++i)
+                value[i] = _M_buffer[(head + i) & (N-1)];
+
+            if (n)
+                _M_head.store(head + n, std::memory_order_release);
+            return n;
+        }
+
+        bool
+        pop(Tp &value)
+        { return pop_n(&value, 1) == 1; }
+
+        // approximate, when called concurrently...
+        //
+
+        bool
+        empty() const
+        {
+            return _M_tail.load(std::memory_order_acquire) == _M_head.load(std::memory_order_relaxed);
+        }
+
+        std::size_t
+        size() const
+        {
+            return _M_tail.load(std::memory_order_acquire) - _M_head.load(std::memory_order_acquire);
+        }
+
+        static constexpr std::size_t
+        capacity()
+        { return N; }
+    };
+
+    // Bounded multi-producer/single-consumer ring, after D. Vyukov's bounded
+    // queue: producers claim a range of slots with a CAS on the tail and 
+    // publish every slot by its sequence number; the consumer pops the slots
+    // published in order and releases them with a single store of the head.
+
+    template <typename Tp, std::size_t N = 1024>
+    class mpsc_ring
+    {
+        static_assert((N & (N-1)) == 0, "mpsc_ring: capacity must be a power of 2");
+
+    public:
+        typedef Tp  value_type;
+
+    private:
+        struct cell
+        {
+            std::atomic<std::size_t>    seq;    /* position + 1, once published */
+            Tp                          value;
+        };
+
+        std::atomic<std::size_t>    _M_head;        /* consumer */
+        char                        _M_pad0[cacheline_size - sizeof(std::atomic<std::size_t>)];
+        std::atomic<std::size_t>    _M_tail;        /* producers */
+        char                        _M_pad1[cacheline_size - sizeof(std::atomic<std::size_t>)];
+        cell                        _M_buffer[N];
+
+    public:
+        mpsc_ring()
+        : _M_head(0), _M_pad0(), _M_tail(0), _M_pad1()
+        {
+            for(std::size_t i = 0; i < N; ++i)
+                _M_buffer[i].seq.store(0, std::memory_order_relaxed);
+        }
+
+        mpsc_ring(const mpsc_ring &) = delete;
+        mpsc_ring& operator=(const mpsc_ring &) = delete;
+
+        // producers side: push up to n values, return the number pushed...
+        //
+
+        std::size_t
+        push_n(const Tp *value, std::size_t n)
+        {
+            std::size_t tail = _M_tail.load(std::memory_order_relaxed), k;
+            do
+            {
+                std::size_t head = _M_head.load(std::memory_order_acquire);
+                k = std::min(n, N - (tail - head));
+                if (!k)
+                    return 0;
+            }
+            while (!_M_tail.compare_exchange_weak(tail, tail + k, std::memory_order_relaxed, std::memory_order_relaxed));
+
+            for(std::size_t i = 0; i < k; ++i)
+            {
+                cell & c = _M_buffer[(tail + i) & (N-1)];
+                c.value = value[i];
+                c.seq.store(tail + i + 1, std::memory_order_release);
+            }
+            return k;
+        }
+
+        bool
+        push(const Tp &value)
+        { return push_n(&value, 1) == 1; }
+
+        // consumer side: pop up to n published values, return the number popped...
+        //
+
+        std::size_t
+        pop_n(Tp *value, std::size_t n)
+        {
+            std::size_t head = _M_head.load(std::memory_order_relaxed), i = 0;
+
+            for(; i < n; ++i)
+            {
+                cell & c = _M_buffer[(head + i) & (N-1)];
+                if (c.seq.load(std::memory_order_acquire) != head + i + 1)
+                    break;
+                value[i] = c.value;
+            }
+
+            if (i)
+                _M_head.store(head + i, std::memory_order_release);
+            return i;
+        }
+
+        bool
+        pop(Tp &value)
+        { return pop_n(&value, 1) == 1; }
+
+        // approximate, when called concurrently (claimed slots count)...
+        //
+
+        bool
+        empty() const
+        {
+            return _M_tail.load(std::memory_order_acquire) == _M_head.load(std::memory_order_relaxed);
+        }
+
+        std::size_t
+        size() const
+        {
+            return _M_tail.load(std::memory_order_acquire) - _M_head.load(std::memory_order_acquire);
+        }
+
+        static constexpr std::size_t
+        capacity()
+        { return N; }
+    };
+
+    // Sequence lock for a single writer and any number of readers (H. Boehm,
+    // "Can Seqlocks Get Along With Programming Language Memory Models?", MSPC 2012).
+    //
+    // The writer never waits: readers retry if a write overlapped their read.
+    // The value is kept in relaxed atomic words, hence Tp must be trivially 
+    // copyable.
+
+    template <typename Tp>
+    class seqlock
+    {
+        static_assert(std::is_trivially_copyable<Tp>::value, "seqlock: Tp must be trivially copyable");
+
+        static const std::size_t words = (sizeof(Tp) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        std::atomic<unsigned long>  _M_seq;
+        std::atomic<uint64_t>       _M_data[words];
+
+        void
+        _M_store(const Tp &value)
+        {
+            uint64_t buf[words] = {};
+            std::memcpy(buf, &value, sizeof(Tp));
+            for(std::size_t i = 0; i < words; ++i)
+                _M_data[i].store(buf[i], std::memory_order_relaxed);
+        }
+
+        Tp
+        _M_load() const
+        {
+            uint64_t buf[words];
+            for(std::size_t i = 0; i < words; ++i)
+                buf[i] = _M_data[i].load(std::memory_order_relaxed);
+            Tp ret;
+            std::memcpy(&ret, buf, sizeof(Tp));
+            return ret;
+        }
+
+    public:
+        explicit seqlock(const Tp &value = Tp())
+        : _M_seq(0)
+        {
+            _M_store(value);
+        }
+
+        seqlock(const seqlock &) = delete;
+        seqlock& operator=(const seqlock &) = delete;
+
+        // writer side...
+        //
+
+        void
+        store(const Tp &value)
+        {
+            unsigned long s = _M_seq.load(std::memory_order_relaxed);
+            _M_seq.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            _M_store(value);
+            _M_seq.store(s + 2, std::memory_order_release);
+        }
+
+        // the writer reads its own value without synchronization...
+        //
+
+        Tp
+        value() const
+        { return _M_load(); }
+
+        // readers side...
+        //
+
+        Tp
+        load() const
+        {
+            for(;;)
+            {
+                unsigned long s0 = _M_seq.load(std::memory_order_acquire);
+                if (s0 & 1) {
+                    detail::cpu_relax();
+                    continue;
+                }
+                Tp ret = _M_load();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (_M_seq.load(std::memory_order_relaxed) == s0)
+                    return ret;
+            }
+        }
+    };
+
+    // Event count (futex): a thread blocks until a condition, that it cannot
+    // wait for without a lock, may have changed. The waiter takes a key by 
+    // prepare(), checks the condition and either cancel()s or wait()s for the 
+    // key; a notifier changes the condition and calls notify(), that is a 
+    // fence and a load when nobody waits (no system call).
+
+    class eventcount
+    {
+        std::atomic<uint32_t>   _M_seq;
+        std::atomic<uint32_t>   _M_waiters;
+
+    public:
+        eventcount()
+        : _M_seq(0), _M_waiters(0)
+        {}
+
+        eventcount(const eventcount &) = delete;
+        eventcount& operator=(const eventcount &) = delete;
+
+        uint32_t
+        prepare()
+        {
+            _M_waiters.fetch_add(1, std::memory_order_seq_cst);
+            return _M_seq.load(std::memory_order_seq_cst);
+        }
+
+        void
+        cancel()
+        {
+            _M_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void
+        wait(uint32_t key)
+        {
+#ifdef __linux__
+            while (_M_seq.load(std::memory_order_acquire) == key)
+                ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&_M_seq), FUTEX_WAIT_PRIVATE, key, 0, 0, 0);
+#else
+            while (_M_seq.load(std::memory_order_acquire) == key)
+                std::this_thread::yield();
+#endif
+            _M_waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void
+        notify()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!_M_waiters.load(std::memory_order_relaxed))
+                return;
+            _M_seq.fetch_add(1, std::memory_order_seq_cst);
+#ifdef __linux__
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&_M_seq), FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+#endif
+        }
+    };
+
+} // namespace qrt
+
+#endif /* _QRT_LOCKFREE_HPP_ */
@@ -25,12 +25,20 @@
 
 #include <qrt_utils.hpp>   
 #include <qrt_heap.hpp>
+#include <qrt_lockfree.hpp>
+#include <qrt_histogram.hpp>
+#include <qrt_trace.hpp>
+#include <qrt_admission.hpp>
+#include <qrt_event.hpp>
+#include <qrt_topology.hpp>
 
 #include <iostream>
 #include <stdexcept>
 #include <vector>
+#include <algorithm>
 #include <memory>
 #include <thread>
+#include <mutex>
 
 #ifdef __linux__
 #include <pthread.h>
@@ -40,30 +48,184 @@ namespace qrt {
 
     ///////////////////// statistic for qrt::thread
 
+    // lateness: cycles between the deadline and the dispatch (0 if on time), 
+    //           for every dispatch
+    // slack:    cycles between an early dispatch and the deadline
+    //
+    // otime and mean are the max and the mean of the missed deadlines. The
+    // stat of a running scheduler are written by its thread: merge() snapshots 
+    // taken after join().
+
     template <typename T> 
     struct stat_type 
     {
         int                      miss;
         int                      sched;
+        int                      batch;     /* dispatch batches (coalesce_window) */
+        int                      dropped;   /* threads rejected by a bounded heap */
         typename T::cycles_type  otime;
         typename T::cycles_type  mean;
 
+        histogram                lateness;
+        histogram                slack;
+
         stat_type() 
-        : miss(0), sched(0), otime(0), mean(0) 
+        : miss(0), sched(0), batch(0), dropped(0), otime(0), mean(0), lateness(), slack() 
+        {}
+
+        void
+        merge(const stat_type &rhs)
+        {
+            miss  += rhs.miss;
+            sched += rhs.sched;
+            batch += rhs.batch;
+            dropped += rhs.dropped;
+            otime  = std::max(otime, rhs.otime);
+            lateness.merge(rhs.lateness);
+            slack.merge(rhs.slack);
+            mean   = miss ? (mean * (miss - rhs.miss) + rhs.mean * rhs.miss) / miss : 0;
+        }
+    };
+
+    // per-thread statistics, maintained by the scheduler loop when Stat is 
+    // stat_per_thread and read through a seqlock (basic_thread::stat):
+    //
+    // exec is measured from the later of the dispatch and the deadline, since
+    // a thread dispatched early spins until its deadline (minus its slack, if
+    // coalesced).
+
+    template <typename T>
+    struct thread_stat
+    {
+        unsigned long            activations;
+        unsigned long            misses;
+        unsigned long            skipped;       /* activations dropped by the overrun policy */
+        typename T::cycles_type  exec;          /* cycles spent in run() */
+        typename T::cycles_type  wcet;          /* worst-case execution time observed */
+        typename T::cycles_type  lateness_min;
+        typename T::cycles_type  lateness_max;
+
+        thread_stat()
+        : activations(0), misses(0), skipped(0), exec(0), wcet(0), lateness_min(0), lateness_max(0)
         {}
     };
 
     struct stat_disabled {};
     struct stat_enabled  {};
+    struct stat_per_thread : stat_enabled {};
+
+    ///////////////////// deadline-overrun policy (per thread)
+
+    // what the scheduler does when run() returns a deadline that is already 
+    // past, that is when the next activation of the thread would be late:
+    //
+    // none:     dispatch it as soon as possible (default)
+    // skip:     drop the missed activations, up to the next period boundary
+    // catch_up: dispatch up to max_burst late activations back-to-back, then skip
+    // degrade:  ask the thread, basic_thread::degrade() returns the deadline
+    //
+    // The period is the one of the periodic_task model if any, the distance 
+    // between the two last deadlines otherwise.
+
+    struct overrun
+    {
+        enum policy_t { none, skip, catch_up, degrade };
+
+        policy_t    policy;
+        unsigned    max_burst;
+
+        overrun(policy_t p = none, unsigned burst = 0)
+        : policy(p), max_burst(burst)
+        {}
+    };
 
     template <typename T>
     std::ostream &
     operator<<(std::ostream &out, const stat_type<T> &s)
     {
         return out << "[" << s.sched << " context-swiches, " << s.miss << " missed deadline, " << 
-                s.otime << " max_delay, " << s.mean << " average_dalay]";        
+                s.otime << " max_delay, " << s.mean << " average_dalay, lateness " << s.lateness << "]";        
     }
     
+    ///////////////////// admission state of a scheduler
+
+    // the threads admitted by a scheduler. A thread that terminates is released
+    // by the scheduler thread (of its group, possibly a peer) without locking: 
+    // it is pushed in the lock-free released ring, and the admission side 
+    // (admit, utilization...) applies the pending releases under the lock.
+    // Until then the released utilization is still accounted for, which errs
+    // on the safe side. The keys are not dereferenced.
+
+    template <typename T, typename Key>
+    struct admission_state
+    {
+        static const std::size_t release_ring = 1024;
+
+        std::mutex                          lock;
+        edf_admission<T, Key>               edf;
+        mpsc_ring<Key, release_ring>        released;
+
+        admission_state()
+        : lock(), edf(), released()
+        {}
+
+        // scheduler thread: lock-free, unless the ring is full...
+        //
+
+        void
+        release(Key key)
+        {
+            if (likely(released.push(key)))
+                return;
+            std::lock_guard<std::mutex> guard(lock);
+            reclaim();
+            edf.release(key);
+        }
+
+        // lock held...
+        //
+
+        void
+        reclaim()
+        {
+            Key keys[64];
+            for(std::size_t n; (n = released.pop_n(keys, 64)) != 0; )
+                for(std::size_t i = 0; i < n; ++i)
+                    edf.release(keys[i]);
+        }
+    };
+
+    ///////////////////// stop of a persistent scheduler
+
+    // drain: dispatch until there is no thread left, then stop
+    // abort: stop at the next dispatch, the threads stay queued
+    
+    struct stop_mode
+    {
+        enum type_t { none = 0, drain = 1, abort = 2 };
+    };
+
+    // observe a stop request of a scheduler (e.g. from its threads, to 
+    // terminate during a drain)...
+
+    class stop_token
+    {
+        const std::atomic<int> * _M_state;
+
+    public:
+        explicit stop_token(const std::atomic<int> *state = 0)
+        : _M_state(state)
+        {}
+
+        bool
+        stop_requested() const
+        { return _M_state && _M_state->load(std::memory_order_relaxed) != stop_mode::none; }
+
+        bool
+        stop_possible() const
+        { return _M_state != 0; }
+    };
+
     ///////////////////// forward declaration
 
     template <typename T /* timestamp counter */, typename Native, 
@@ -74,6 +236,10 @@ namespace qrt {
         template <typename, typename> class Heap, typename>
     class basic_scheduler; /* forward declaration */
 
+    template <typename T, typename Native,  
+        template <typename, typename> class Heap, typename>
+    class scheduler_group; /* forward declaration */
+
     ///////////////////// scheduler_thread 
     
     template <typename T, typename Native, template <typename, typename> class Heap, typename Stat>
@@ -83,46 +249,206 @@ namespace qrt {
         typedef basic_thread<T, Native, Heap>           thread_type;
 
         typedef void result_type;
+
+        // apply the overrun policy of the thread to the deadline returned by
+        // run(), current being the deadline of the activation just ended...
+        //
+
+        static typename T::cycles_type
+        _S_overrun(thread_type *t, typename T::cycles_type current, typename T::cycles_type deadline, 
+                   unsigned long &skipped)
+        {
+            typename T::cycles_type now = T::get_cycles();
+
+            if (deadline >= now) {
+                t->_M_burst = 0;
+                return deadline;
+            }
+
+            switch(t->overrun_policy().policy)
+            {
+            case overrun::none:
+                return deadline;
+            case overrun::degrade:
+                return t->degrade(deadline, now);
+            case overrun::catch_up:
+                if (t->_M_burst < t->overrun_policy().max_burst) {
+                    t->_M_burst++;
+                    return deadline;
+                }
+                /* fall through */
+            case overrun::skip:
+                break;
+            }
+
+            t->_M_burst = 0;
+
+            typename T::cycles_type period = t->task().period ? : 
+                                             (deadline > current ? deadline - current : 0);
+            if (!period)
+                return deadline;
+
+            typename T::cycles_type n = (now - deadline) / period + 1;
+            skipped += n;
+            return deadline + n * period;
+        }
+
+        // dispatch a thread and put it back, or park/retire it...
+        //
+
+        static void
+        _S_dispatch(sched_type *sched, thread_type *t, trace_ring *trace, 
+                    std::vector<std::pair<typename T::cycles_type, thread_type *> > *batch)
+        {
+            // wait for the first deadline for this thread (in a batch, the head
+            // has been waited for and the others are due: only a thread queued
+            // before its begin() is to wait)...
+            //
+            bool waited = batch && t->begin() <= t->next_deadline() ? false : T::busywait_until(t->begin());
+
+            if (unlikely(trace != 0))
+            {
+                typename T::cycles_type tsc = T::get_cycles();
+                trace->record(trace_event::dispatch, t->get_id(), t->next_deadline(), tsc);
+                if (!waited && t->next_deadline() < tsc)
+                    trace->record(trace_event::miss, t->get_id(), tsc - t->next_deadline(), tsc);
+            }
+
+            typename T::cycles_type now = 0, late = 0;
+
+            if (std::is_base_of<qrt::stat_enabled, Stat>::value) 
+            { // if stat are enabled...
+
+                now = T::get_cycles();
+                stat_type<T> &s = sched->stat();
+
+                if (!waited && t->next_deadline() < now)   // is this a missed deadline?  
+                {
+                    typename T::cycles_type diff = late = now - t->next_deadline();
+                    s.miss++;
+                    s.otime = std::max(s.otime,diff);
+                    s.mean += (static_cast<long long>(diff) - static_cast<long long>(s.mean)) / s.miss;
+                    s.lateness.record(diff);
+                }
+                else
+                {
+                    s.lateness.record(0);
+                    if (t->next_deadline() > now)
+                        s.slack.record(t->next_deadline() - now);
+                }
+            }
+
+            // run the thread...
+            t->wake_queue(&sched->submit_queue());
+
+            typename T::cycles_type current  = t->next_deadline();
+            typename T::cycles_type early    = std::min(t->_M_slack, current);  /* the thread waits for current - early */
+            t->_M_slack = 0;
+
+            typename T::cycles_type deadline = t->run(current);
+            unsigned long skipped = 0;
+
+            if (deadline && unlikely(t->overrun_policy().policy != overrun::none))
+                deadline = _S_overrun(t, current, deadline, skipped);
+
+            if (unlikely(trace != 0))
+                trace->record(deadline ? trace_event::ret : trace_event::finish, t->get_id(), deadline, T::get_cycles());
+
+            if (std::is_same<Stat, qrt::stat_per_thread>::value)
+            { // per-thread stat...
+
+                typename T::cycles_type from = std::max(now, current - early), end = T::get_cycles();
+                typename T::cycles_type exec = end > from ? end - from : 0;
+                thread_stat<T> ts = t->stat_seqlock().value();
+
+                ts.lateness_min = ts.activations ? std::min(ts.lateness_min, late) : late;
+                ts.lateness_max = std::max(ts.lateness_max, late);
+                ts.activations++;
+                ts.misses += late != 0;
+                ts.skipped += skipped;
+                ts.exec += exec;
+                ts.wcet  = std::max(ts.wcet, exec);
+
+                t->stat_seqlock().store(ts);
+            }
+
+            if (deadline)
+            {
+                if (unlikely(t->watched_fd() >= 0 || t->suspended()))
+                {
+                    // suspended until its fd is ready or it is woken...
+                    sched->park(t);
+                }
+                else
+                {
+                    // store the next deadline for this thread..
+                    t->next_deadline(deadline);
+
+                    // reschedule (at the end of the batch, if any)... 
+                    if (batch)
+                        batch->push_back(std::make_pair(deadline, t));
+                    else
+                        sched->requeue(t, deadline);
+                }
+
+                if (std::is_base_of<qrt::stat_enabled, Stat>::value)
+                    sched->stat().sched++;
+            }
+            else 
+            {
+                // the thread is terminated...
+                sched->retire(t);
+            }
+        }
+
         void operator()(sched_type *sched)
         {
+            trace_ring * trace = sched->trace();
+
+            std::vector<thread_type *> due;
+            std::vector<std::pair<typename T::cycles_type, thread_type *> > batch;
+
+            due.reserve(sched_type::coalesce_batch);
+            batch.reserve(sched_type::coalesce_batch);
+
             // scheduler main loop
             for(;;) 
             {            
-                thread_type * t = sched->eligible();
+                thread_type * t = sched->stop_pending() == stop_mode::abort ? 0 : sched->eligible();
 
-                if (unlikely(!t)) 
+                if (unlikely(!t)) {
+                    if (sched->wait_for_work())     /* persistent only */
+                        continue;
                     break;
-                
-                // wait for the first deadline for this thread...
-                //
-                if (!T::busywait_until(t->begin()))  
-                {   
-                    if (std::is_same<Stat, qrt::stat_enabled>::value) 
-                    { // if stat are enabled...
-
-                        if (t->next_deadline() < T::get_cycles())   // is this a missed deadline?  
-                        {
-                            typename T::cycles_type diff = T::get_cycles()-t->next_deadline();
-                            sched->stat().miss++;
-                            sched->stat().otime = std::max(sched->stat().otime,diff);
-                            sched->stat().mean = (sched->stat().otime + diff)>>1;
-                        }
-                    }
                 }
 
-                // run the thread...
-                typename T::cycles_type deadline = t->run(t->next_deadline());
-                if (deadline)
-                {
-                    // store the next deadline for this thread..
-                    t->next_deadline(deadline);
-
-                    // reschedule... 
-                    sched->operator()(t, deadline);
+                const typename T::cycles_type window = sched->coalesce_window();
 
-                    if (std::is_same<Stat, qrt::stat_enabled>::value)
-                        sched->stat().sched++;
+                if (likely(window == 0)) {
+                    _S_dispatch(sched, t, trace, 0);
+                    continue;
                 }
+
+                // batch mode: wait for the head, take all the threads due by 
+                // then (early within their slack), run them back-to-back and 
+                // put them back at once...
+                //
+
+                T::busywait_until(t->next_deadline());
+
+                due.clear();
+                due.push_back(t);
+                sched->collect(due, T::get_cycles());
+
+                if (std::is_base_of<qrt::stat_enabled, Stat>::value)
+                    sched->stat().batch++;
+
+                batch.clear();
+                for(thread_type * u : due)
+                    _S_dispatch(sched, u, trace, &batch);
+
+                if (!batch.empty())
+                    sched->requeue(batch);
             }
         }
     };
@@ -131,10 +457,13 @@ namespace qrt {
 
     struct null_native_thread
     {
-        static void set_affinity(int) 
+        static void set_affinity(std::thread &, int) 
+        {} 
+
+        static void set_affinity(std::thread &, const cpu_mask &) 
         {} 
 
-        static void set_schedparam(int,int)
+        static void set_schedparam(std::thread &, int,int)
         {}
     };
     
@@ -151,26 +480,177 @@ namespace qrt {
 
         typedef Heap< typename T::cycles_type, basic_thread<T, Native, Heap> *> heap_type;
         typedef basic_thread<T, Native, Heap> thread_type;
+        typedef scheduler_group<T, Native, Heap, Stat> group_type;
+
+        friend class scheduler_group<T, Native, Heap, Stat>;
+
+        // max number of submitted threads moved into the heap per dispatch...
+
+        static const std::size_t submit_batch = 64;
+
+        // max number of threads dispatched in a batch (see coalesce_window)...
+
+        static const std::size_t coalesce_batch = 64;
+
+        // max number of ready events harvested at once...
+
+        static const std::size_t harvest_batch = 64;
 
     protected:
         heap_type       _M_heap;
         std::thread     _M_thread;
 
-        int             _M_cpu;
+        cpu_mask        _M_cpu;
         int             _M_policy;
         int             _M_prio;
     
         stat_type<T>    _M_stat;
 
+        group_type *    _M_group;   /* work-stealing group, if any */
+        std::size_t     _M_slot;    /* index within the group */
+
+        std::unique_ptr<mpsc_queue<thread_type> > _M_submit;    /* threads submitted while running */
+
+        trace_ring *    _M_trace;   /* scheduling trace, if any */
+
+        typedef qrt::admission_state<T, thread_type *> admission_state;
+
+        std::unique_ptr<admission_state> _M_admission;   /* threads with a periodic_task model */
+
+        struct control_state
+        {
+            std::atomic<int>    stop;       /* stop_mode */
+            std::atomic<bool>   stopped;    /* parked after a stop */
+            std::atomic<bool>   exit;       /* join(): leave once stopped */
+            eventcount          event;      /* the scheduler parks here */
+
+            control_state()
+            : stop(stop_mode::none), stopped(false), exit(false), event()
+            {}
+        };
+
+        bool            _M_persistent;
+        std::unique_ptr<control_state> _M_control;
+
+        bool
+        _M_has_work() const
+        {
+            return !_M_heap.empty() || _M_waiting || !_M_submit->empty();
+        }
+
+        typename T::cycles_type _M_window;     /* coalescing window, 0 = off */
+
+        event_source *  _M_wake;    /* readiness of the fds, if any */
+        std::size_t     _M_waiting; /* threads parked on their fd */
+
+        std::vector<lockable_memory *> _M_locked;  /* locked by start() */
+
+        // make the threads whose fd is ready eligible now...
+        //
+
+        void
+        _M_harvest()
+        {
+            if (!_M_wake)
+                return;
+
+            event_ready ready[harvest_batch];
+            std::size_t n = _M_wake->harvest(ready, harvest_batch);
+            if (!n)
+                return;
+
+            typename T::cycles_type now = T::get_cycles();
+            for(std::size_t i = 0; i < n; ++i)
+            {
+                thread_type * t = static_cast<thread_type *>(ready[i].cookie);
+                t->revents(ready[i].revents);
+                t->next_deadline(now);
+                if (_M_trace)
+                    _M_trace->record(trace_event::wake, t->get_id(), ready[i].revents, now);
+                _M_push(now, t);
+            }
+            _M_waiting -= n;
+        }
+
+        // while threads are parked, the scheduler waits for the next deadline
+        // itself, harvesting the ready events in the meantime...
+        //
+
+        thread_type *
+        _M_eligible_wait()
+        {
+            for(;;)
+            {
+                if (unlikely(_M_control->stop.load(std::memory_order_relaxed) == stop_mode::abort))
+                    return 0;
+
+                _M_harvest();
+
+                if (_M_group) {
+                    thread_type * t = _M_group->eligible(*this);
+                    if (t || !_M_waiting)
+                        return t;
+                    continue;
+                }
+
+                drain();
+
+                if (_M_heap.empty()) {
+                    if (!_M_waiting)
+                        return 0;
+                    continue;
+                }
+
+                if (!_M_waiting || _M_heap.top().first <= T::get_cycles())
+                    return _M_heap.pop_value();
+            }
+        }
+
+        // push a thread the scheduler already owns: one a bounded heap rejects
+        // (overflow_reject) is retired and counted as dropped...
+        //
+
+        void
+        _M_push(typename T::cycles_type deadline, thread_type *t)
+        {
+            t->set_heap(_M_heap);
+            if (likely(detail::heap_push(_M_heap, deadline, t)))
+                return;
+            _M_drop(t);
+        }
+
+        void
+        _M_drop(thread_type *t)
+        {
+            if (std::is_base_of<qrt::stat_enabled, Stat>::value)
+                _M_stat.dropped++;
+            if (_M_trace)
+                _M_trace->record(trace_event::finish, t->get_id(), 0, T::get_cycles());
+            retire(t);
+        }
+
+        void
+        _M_admit(thread_type *t)
+        {
+            if (!t->task().period)
+                return;
+            std::lock_guard<std::mutex> lock(_M_admission->lock);
+            _M_admission->reclaim();
+            if (!_M_admission->edf.admit(t, t->task()))
+                throw std::runtime_error("qrt::scheduler: admission control, EDF not feasible");
+            t->admission(_M_admission.get());
+        }
+
     public:
         basic_scheduler()
-        :  _M_heap(), _M_thread(), _M_cpu(), _M_policy(), _M_prio(), _M_stat()  
+        :  _M_heap(), _M_thread(), _M_cpu(cpu_mask::single(0)), _M_policy(), _M_prio(), _M_stat(), _M_group(), _M_slot(), 
+           _M_submit(new mpsc_queue<thread_type>), _M_trace(), _M_admission(new admission_state), 
+           _M_persistent(), _M_control(new control_state), _M_window(), _M_wake(), _M_waiting(), _M_locked()
         {}
 
         ~basic_scheduler()
         {
-            if (_M_thread.joinable())
-                _M_thread.join();
+            join();
         }
 
         basic_scheduler(const basic_scheduler &) = delete;
@@ -182,7 +662,18 @@ namespace qrt {
           _M_cpu(std::move(rhs._M_cpu)),
           _M_policy(std::move(rhs._M_policy)),
           _M_prio(std::move(rhs._M_prio)),
-          _M_stat(std::move(rhs._M_stat)) 
+          _M_stat(std::move(rhs._M_stat)),
+          _M_group(rhs._M_group),
+          _M_slot(rhs._M_slot), 
+          _M_submit(std::move(rhs._M_submit)),
+          _M_trace(rhs._M_trace),
+          _M_admission(std::move(rhs._M_admission)),
+          _M_persistent(rhs._M_persistent),
+          _M_control(std::move(rhs._M_control)),
+          _M_window(rhs._M_window),
+          _M_wake(rhs._M_wake),
+          _M_waiting(rhs._M_waiting),
+          _M_locked(std::move(rhs._M_locked))
         {}
 
         basic_scheduler& operator=(basic_scheduler &&rhs)
@@ -193,22 +684,236 @@ namespace qrt {
             _M_policy = std::move(rhs._M_policy);
             _M_prio   = std::move(rhs._M_prio);
             _M_stat   = std::move(rhs._M_stat); 
+            _M_group  = rhs._M_group;
+            _M_slot   = rhs._M_slot;
+            _M_submit = std::move(rhs._M_submit);
+            _M_trace  = rhs._M_trace;
+            _M_admission = std::move(rhs._M_admission);
+            _M_window = rhs._M_window;
+            _M_wake   = rhs._M_wake;
+            _M_waiting = rhs._M_waiting;
+            _M_locked = std::move(rhs._M_locked);
+            _M_persistent = rhs._M_persistent;
+            _M_control = std::move(rhs._M_control);
             return *this;
         }
 
-        // schedule and setup the heap...
+        // schedule and setup the heap. Threads with a periodic_task model pass the
+        // admission control first: std::runtime_error if the EDF schedule would
+        // not be feasible any longer, or if a bounded heap is full.
         //
 
         void
         operator()( basic_thread<T, Native, Heap> *t, typename T::cycles_type deadline = 0)
         {
+            if (std::is_same<Stat, qrt::stat_per_thread>::value)
+                t->alloc_stat();
+            _M_admit(t);
+            if (_M_group)
+                _M_group->enter(t);
+            t->next_deadline(deadline ? : t->begin());
             t->set_heap(_M_heap);
-            _M_heap.push(deadline ? : t->begin(), t);
+            if (!detail::heap_push(_M_heap, t->next_deadline(), t)) {
+                retire(t);
+                throw std::runtime_error("qrt::scheduler: heap full");
+            }
+            if (_M_trace)
+                _M_trace->record(trace_event::add, t->get_id(), deadline ? : t->begin(), T::get_cycles());
         } 
 
+        // schedule a thread from any thread, even while the scheduler is running
+        // (wait-free). The scheduler moves it into the heap before the next dispatch. 
+        // Note: a scheduler with an empty heap terminates, hence submit() must not race
+        // with the end of the last thread.
+        //
+
+        void
+        submit( basic_thread<T, Native, Heap> *t, typename T::cycles_type deadline = 0)
+        {
+            if (std::is_same<Stat, qrt::stat_per_thread>::value)
+                t->alloc_stat();
+            _M_admit(t);
+            if (_M_group)
+                _M_group->enter(t);
+            t->next_deadline(deadline ? : t->begin());
+            _M_submit->push(&t->link());
+            if (_M_persistent)      /* only a persistent scheduler parks */
+                _M_control->event.notify();
+        }
+
+        // move the submitted threads into the heap (scheduler thread only)...
+        //
+
+        std::size_t
+        drain()
+        {
+            std::size_t n = 0;
+            for(thread_type * t; n < submit_batch && (t = _M_submit->pop()); ++n)
+            {
+                if (unlikely(t->suspended())) {     /* woken */
+                    t->resume();
+                    t->next_deadline(T::get_cycles());
+                    _M_waiting--;
+                }
+                if (_M_trace)
+                    _M_trace->record(trace_event::add, t->get_id(), t->next_deadline(), T::get_cycles());
+                _M_push(t->next_deadline(), t);
+            }
+            return n;
+        }
+
+        // put back a thread that returned from run() (scheduler thread only)...
+        //
+
+        void
+        requeue( basic_thread<T, Native, Heap> *t, typename T::cycles_type deadline)
+        {
+            _M_push(deadline, t);
+        }
+
+        // put back the threads of a batch, with a single heap rebuild if the
+        // policy supports it (scheduler thread only)...
+        //
+
+        void
+        requeue(const std::vector<std::pair<typename T::cycles_type, thread_type *> > &batch)
+        {
+            for(auto &e : batch)
+                e.second->set_heap(_M_heap);
+            for(auto it = detail::heap_push_bulk(_M_heap, batch.begin(), batch.end()); it != batch.end(); ++it)
+                _M_drop(it->second);
+        }
+
+        // pop the threads due by now plus their slack, bounded by the coalescing
+        // window, in order and up to coalesce_batch (scheduler thread only)...
+        //
+
+        void
+        collect(std::vector<thread_type *> &due, typename T::cycles_type now)
+        {
+            while (due.size() < coalesce_batch && !_M_heap.empty())
+            {
+                thread_type * t = _M_heap.top().second;
+                if (_M_heap.top().first > now + std::min(_M_window, t->slack()))
+                    break;
+                due.push_back(_M_heap.pop_value());
+            }
+        }
+
+        // a thread suspended by qrt_wait_fd or qrt_wait_recv (scheduler thread 
+        // only). The latter comes back through the submission queue...
+        //
+
+        void
+        park( basic_thread<T, Native, Heap> *t)
+        {
+            if (t->watched_fd() >= 0)
+            {
+                if (!_M_wake)
+                    throw std::runtime_error("qrt::scheduler: qrt_wait_fd without an event source");
+                _M_wake->watch(t->watched_fd(), t->watched_events(), t);
+                t->watch_fd(-1, 0);
+            }
+            _M_waiting++;
+        }
+
+        // a thread returned 0 from run() (scheduler thread only)...
+        //
+
+        void
+        retire( basic_thread<T, Native, Heap> *t)
+        {
+            if (_M_group)
+                _M_group->leave(t);
+            if (unlikely(t->admission() != 0)) {
+                admission_state * a = t->admission();   /* it may have been admitted by a peer */
+                t->admission(0);
+                a->release(t);
+            }
+        }
+
+        // remove a queued thread and retire it, as if it returned 0 from run().
+        // false if the thread is not in the heap (running, parked, submitted or 
+        // stolen by a peer). Scheduler thread only (e.g. from another thread of 
+        // the same scheduler), or while not running. The heap policy must track
+        // its elements: indexed::heap (O(log n)) or redblack::heap.
+        //
+
+        bool
+        cancel( basic_thread<T, Native, Heap> *t)
+        {
+            if (!_M_heap.erase(t->next_deadline(), t))
+                return false;
+            if (_M_trace)
+                _M_trace->record(trace_event::finish, t->get_id(), 0, T::get_cycles());
+            retire(t);
+            return true;
+        }
+
+        // move a queued thread to a new deadline, same rules as cancel(). The
+        // thread is dispatched at the new deadline, which it sees by means of
+        // next_deadline() (see qrt_next_period).
+        //
+
+        bool
+        reschedule( basic_thread<T, Native, Heap> *t, typename T::cycles_type deadline)
+        {
+            if (!_M_heap.update(t->next_deadline(), t, deadline))
+                return false;
+            t->next_deadline(deadline);
+            if (_M_trace)
+                _M_trace->record(trace_event::add, t->get_id(), deadline, T::get_cycles());
+            return true;
+        }
+
+        // admission control: the threads with a periodic_task model are admitted
+        // as long as they are EDF-feasible on a fraction cap of the cpu...
+        //
+
+        double
+        utilization_cap() const
+        { 
+            std::lock_guard<std::mutex> lock(_M_admission->lock);
+            return _M_admission->edf.cap(); 
+        }
+
+        void
+        utilization_cap(double value)
+        { 
+            std::lock_guard<std::mutex> lock(_M_admission->lock);
+            _M_admission->reclaim();
+            _M_admission->edf.cap(value); 
+        }
+
+        // utilization of the admitted threads...
+
+        double
+        utilization() const
+        { 
+            std::lock_guard<std::mutex> lock(_M_admission->lock);
+            _M_admission->reclaim();
+            return _M_admission->edf.utilization(); 
+        }
+
+        bool
+        admissible(const periodic_task<T> &task) const
+        { 
+            std::lock_guard<std::mutex> lock(_M_admission->lock);
+            _M_admission->reclaim();
+            return _M_admission->edf.admissible(task); 
+        }
+
         thread_type *
         eligible()
         {
+            if (unlikely(_M_waiting != 0))
+                return _M_eligible_wait();
+
+            if (_M_group)
+                return _M_group->eligible(*this);
+
+            drain();
+
             if (_M_heap.empty())
                 return 0;
             return _M_heap.pop_value();
@@ -217,9 +922,26 @@ namespace qrt {
         void 
         start() 
         {    
+            // (re)start a stopped persistent scheduler, on the same thread...
+            if (_M_persistent && _M_thread.joinable() && !_M_control->exit.load(std::memory_order_relaxed)) 
+            {
+                _M_control->stopped.store(false, std::memory_order_relaxed);
+                _M_control->stop.store(stop_mode::none, std::memory_order_release);
+                _M_control->event.notify();
+                return;
+            }
+
             if(_M_thread.get_id() != std::thread::id())
                throw std::runtime_error("qtr::scheduler already started");
 
+            _M_control->stop.store(stop_mode::none, std::memory_order_relaxed);
+            _M_control->stopped.store(false, std::memory_order_relaxed);
+            _M_control->exit.store(false, std::memory_order_relaxed);
+
+            // prefault and lock the memory of the threads (e.g. their stacks)...
+            for(lockable_memory * m : _M_locked)
+                m->lock();
+
             // start the standard thread..
             _M_thread = std::thread(scheduler_thread<T,Native,Heap,Stat>(), this);
         
@@ -228,11 +950,114 @@ namespace qrt {
             Native::set_schedparam(_M_thread, _M_policy, _M_prio);
         }
 
+        // wait for the end of the scheduler: a persistent scheduler is drained
+        // (if not stopped already) and its thread leaves...
+        //
+
         void 
         join()  
         {   
-            if(_M_thread.joinable())
-                _M_thread.join();
+            if (!_M_thread.joinable())
+                return;
+
+            if (_M_persistent) 
+            {
+                int none = stop_mode::none;
+                _M_control->stop.compare_exchange_strong(none, stop_mode::drain);
+                _M_control->exit.store(true, std::memory_order_release);
+                _M_control->event.notify();
+            }
+
+            _M_thread.join();
+        }
+
+        // persistent scheduler: when there is nothing to dispatch, the thread 
+        // parks on a futex (woken by submit) instead of leaving, until a stop
+        // followed by join(). Set before start...
+        //
+
+        bool
+        persistent() const
+        { return _M_persistent; }
+
+        void
+        persistent(bool value)
+        { _M_persistent = value; }
+
+        // stop a persistent scheduler (see stop_mode): the thread stays parked,
+        // and start() resumes it, without re-creating it...
+        //
+
+        void
+        request_stop(stop_mode::type_t mode = stop_mode::drain)
+        {
+            _M_control->stop.store(mode, std::memory_order_release);
+            _M_control->event.notify();
+        }
+
+        int
+        stop_pending() const
+        { return _M_control->stop.load(std::memory_order_relaxed); }
+
+        stop_token
+        get_stop_token() const
+        { return stop_token(&_M_control->stop); }
+
+        bool
+        stopped() const
+        { return _M_control->stopped.load(std::memory_order_acquire); }
+
+        void
+        wait_stopped() const
+        {
+            while (!stopped() && _M_thread.joinable())
+                std::this_thread::yield();
+        }
+
+        // nothing to dispatch or stopped (scheduler thread only): false if the
+        // thread is to leave, true once there is work again...
+        //
+
+        bool
+        wait_for_work()
+        {
+            if (!_M_persistent)
+                return false;
+
+            for(;;)
+            {
+                const int  stop    = _M_control->stop.load(std::memory_order_acquire);
+                const bool stopped = _M_control->stopped.load(std::memory_order_acquire);
+                const bool exit    = _M_control->exit.load(std::memory_order_acquire);
+
+                if (!stopped)
+                {
+                    if (stop != stop_mode::abort && _M_has_work())
+                        return true;
+                    if (stop != stop_mode::none) {
+                        if (exit)
+                            return false;
+                        _M_control->stopped.store(true, std::memory_order_release);
+                        continue;
+                    }
+                }
+                else if (exit)
+                    return false;
+
+                // park until a submission, a stop, a restart or join()...
+
+                uint32_t key = _M_control->event.prepare();
+
+                if (_M_control->stop.load(std::memory_order_acquire) != stop ||
+                    _M_control->stopped.load(std::memory_order_acquire) != stopped ||
+                    _M_control->exit.load(std::memory_order_acquire) != exit ||
+                    (!stopped && _M_has_work())) {
+                    _M_control->event.cancel();
+                    continue;
+                }
+
+                _M_control->event.wait(key);
+            }
         }
         
         const stat_type<T> &
@@ -246,24 +1071,89 @@ namespace qrt {
         { 
             return _M_stat;
         }
+
+        // record the scheduling events in a trace ring (set before start,
+        // the ring is written by the scheduler thread)...
+        //
+
+        trace_ring *
+        trace() const
+        { return _M_trace; }
+
+        void
+        trace(trace_ring *ring)
+        { _M_trace = ring; }
+
+        // batch dispatch: the threads due within the window of the earliest are
+        // run back-to-back and put back at once, those that opted in by means
+        // of qrt_coalesce even a bit early (at most their slack). 0 disables it 
+        // (default), set before start...
+        //
+
+        typename T::cycles_type
+        coalesce_window() const
+        { return _M_window; }
+
+        void
+        coalesce_window(typename T::cycles_type value)
+        { _M_window = value; }
+
+        // source of the I/O readiness for the threads suspended by qrt_wait_fd
+        // (set before start, used by the scheduler thread only)...
+        //
+
+        event_source *
+        wake_source() const
+        { return _M_wake; }
+
+        void
+        wake_source(event_source *source)
+        { _M_wake = source; }
+
+        // threads waiting for their fd or for a wake()...
+
+        std::size_t
+        waiting() const
+        { return _M_waiting; }
         
         // advanced features, by means of native threads...
         //
 
         int
         affinity() const
-        { return _M_cpu; }
+        { return _M_cpu.first(); }
 
         void
         affinity(int _n)
         {
+            affinity(cpu_mask::single(_n));
+        }
+
+        const cpu_mask &
+        affinity_mask() const
+        { return _M_cpu; }
+
+        void
+        affinity(const cpu_mask &_mask)
+        {
+            if (_mask.empty())
+                throw std::runtime_error("qrt::scheduler: empty affinity mask");
+
             if (this->_M_thread.get_id() != std::thread::id())
             {
-                Native::set_affinity(_M_thread, _n);
+                Native::set_affinity(_M_thread, _mask);
             }
-            _M_cpu = _n;
+            _M_cpu = _mask;
         }
 
+        // memory (e.g. the stack_pool of the stackful threads) prefaulted and 
+        // mlocked by start(), before the scheduler thread is created...
+        //
+
+        void
+        lock_at_start(lockable_memory &m)
+        { _M_locked.push_back(&m); }
+
         void
         schedparam(int _policy, int _prio)
         {
@@ -281,6 +1171,13 @@ namespace qrt {
             return std::make_pair(_M_policy,_M_prio); 
         }
         
+        // the queue of the threads submitted or woken from other threads...
+        //
+
+        mpsc_queue<thread_type> &
+        submit_queue()
+        { return *_M_submit; }
+
         // get the native handle of the scheduler thread...
         //
 
@@ -301,15 +1198,18 @@ namespace qrt {
     {
         static void 
         set_affinity(std::thread &t, int n) 
+        {
+            set_affinity(t, cpu_mask::single(n));
+        }
+
+        static void 
+        set_affinity(std::thread &t, const cpu_mask &mask) 
         {
             if(t.get_id() == std::thread::id())
                 throw std::runtime_error("qrt::scheduler not running");
 
-            cpu_set_t cpuset;
-            CPU_ZERO(&cpuset); CPU_SET(n, &cpuset);
-
             std::thread::native_handle_type pt = t.native_handle();
-            if ( ::pthread_setaffinity_np(pt, sizeof(cpuset), &cpuset) != 0)
+            if ( ::pthread_setaffinity_np(pt, sizeof(cpu_set_t), &mask.native()) != 0)
                 throw std::runtime_error("pthread_setaffinity_np");
         }
 
@@ -335,14 +1235,31 @@ namespace qrt {
 
     typedef basic_scheduler< qrt::this_cpu, linux_native_thread, qrt::random_access::vector_heap, stat_disabled > deadline_scheduler;
     typedef basic_scheduler< qrt::this_cpu, linux_native_thread, qrt::random_access::vector_heap, stat_enabled  > stat_deadline_scheduler;
+    typedef basic_scheduler< qrt::this_cpu, linux_native_thread, qrt::random_access::vector_heap, stat_per_thread > thread_stat_deadline_scheduler;
+    typedef basic_scheduler< qrt::this_cpu, linux_native_thread, qrt::priority::config<qrt::this_cpu>::heap, stat_disabled > fp_scheduler;
+    typedef basic_scheduler< qrt::this_cpu, linux_native_thread, qrt::priority::config<qrt::this_cpu>::heap, stat_enabled  > stat_fp_scheduler;
+    typedef basic_scheduler< qrt::this_cpu, linux_native_thread, qrt::indexed::heap, stat_disabled > indexed_scheduler;
+    typedef basic_scheduler< qrt::this_cpu, linux_native_thread, qrt::indexed::heap, stat_enabled  > stat_indexed_scheduler;
 
 #else
 
     typedef basic_scheduler< qrt::this_cpu, null_native_thread, qrt::random_access::vector_heap, stat_disabled > deadline_scheduler;
     typedef basic_scheduler< qrt::this_cpu, null_native_thread, qrt::random_access::vector_heap, stat_enabled  > stat_deadline_scheduler;
+    typedef basic_scheduler< qrt::this_cpu, null_native_thread, qrt::random_access::vector_heap, stat_per_thread > thread_stat_deadline_scheduler;
+    typedef basic_scheduler< qrt::this_cpu, null_native_thread, qrt::priority::config<qrt::this_cpu>::heap, stat_disabled > fp_scheduler;
+    typedef basic_scheduler< qrt::this_cpu, null_native_thread, qrt::priority::config<qrt::this_cpu>::heap, stat_enabled  > stat_fp_scheduler;
+    typedef basic_scheduler< qrt::this_cpu, null_native_thread, qrt::indexed::heap, stat_disabled > indexed_scheduler;
+    typedef basic_scheduler< qrt::this_cpu, null_native_thread, qrt::indexed::heap, stat_enabled  > stat_indexed_scheduler;
 
 #endif
 
+    // deterministic, faster than real-time schedulers (see virtual_clock)...
+
+    typedef basic_scheduler< qrt::virtual_clock, null_native_thread, qrt::random_access::vector_heap, stat_disabled > virtual_scheduler;
+    typedef basic_scheduler< qrt::virtual_clock, null_native_thread, qrt::random_access::vector_heap, stat_enabled  > stat_virtual_scheduler;
+    typedef basic_scheduler< qrt::virtual_clock, null_native_thread, qrt::priority::config<qrt::virtual_clock>::heap, stat_disabled > virtual_fp_scheduler;
+    typedef basic_scheduler< qrt::virtual_clock, null_native_thread, qrt::priority::config<qrt::virtual_clock>::heap, stat_enabled  > stat_virtual_fp_scheduler;
+
 }
 
 #endif /* _QRT_SCHEDULER_HPP_ */
@@ -0,0 +1,440 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _QRT_TASK_HPP_
+#define _QRT_TASK_HPP_
+
+#if __cplusplus < 202002L
+#error "qrt_task.hpp requires C++20 coroutines (-std=c++20)"
+#endif
+
+#include <qrt_thread.hpp>
+#include <qrt_utils.hpp>
+
+#include <coroutine>
+#include <exception>
+#include <stdexcept>
+#include <utility>
+#include <memory>
+#include <new>
+
+// C++20 coroutine backend:
+//
+//   qrt::task worker(int n)
+//   {
+//       for(int i = 0; i < n; ++i)
+//           co_await qrt::sleep_for(ticks);    // locals survive the suspension
+//   }
+//
+//   qrt::task_thread t(begin, end, worker(10));
+//   sched(&t);
+//
+// The coroutine is resumed by the run() of a basic_task_thread, hence it is
+// driven by the deadline heap of the scheduler as any other basic_thread.
+
+namespace qrt {
+
+    ///////////////////// frame_arena
+    //
+    // bump allocator for coroutine frames, with per-size free lists (frames of
+    // the same coroutine have the same size). One arena per scheduler: it is not
+    // thread-safe, hence frames are expected to be created before start() or by
+    // the scheduler thread itself. Frames are allocated from the arena made
+    // current by a frame_arena::scope, from the global heap otherwise.
+
+    class frame_arena
+    {
+    public:
+        static const std::size_t granularity = 64;
+        static const std::size_t classes     = 64;     /* frames up to 4K */
+
+    private:
+        struct free_block
+        {
+            free_block * next;
+        };
+
+        std::unique_ptr<char[]> _M_buffer;
+        std::size_t             _M_size;
+        std::size_t             _M_used;
+        free_block *            _M_free[classes];
+
+    public:
+        explicit frame_arena(std::size_t size)
+        : _M_buffer(new char[size]), _M_size(size), _M_used(0), _M_free()
+        {}
+
+        frame_arena(const frame_arena &) = delete;
+        frame_arena& operator=(const frame_arena &) = delete;
+
+        // returns 0 when the arena is exhausted...
+        //
+
+        void *
+        allocate(std::size_t n)
+        {
+            const std::size_t c = (n + granularity - 1) / granularity;
+            if (c == 0 || c > classes)
+                return 0;
+
+            if (free_block * b = _M_free[c-1]) {
+                _M_free[c-1] = b->next;
+                return b;
+            }
+
+            if (_M_used + c * granularity > _M_size)
+                return 0;
+
+            void * p = _M_buffer.get() + _M_used;
+            _M_used += c * granularity;
+            return p;
+        }
+
+        void
+        deallocate(void *p, std::size_t n)
+        {
+            const std::size_t c = (n + granularity - 1) / granularity;
+            free_block * b = static_cast<free_block *>(p);
+            b->next = _M_free[c-1];
+            _M_free[c-1] = b;
+        }
+
+        std::size_t
+        used() const
+        { return _M_used; }
+
+        std::size_t
+        size() const
+        { return _M_size; }
+
+        static frame_arena *&
+        current()
+        {
+            static thread_local frame_arena * a;
+            return a;
+        }
+
+        // make an arena current for the coroutines created in this scope...
+        //
+
+        struct scope
+        {
+            frame_arena * _M_prev;
+
+            explicit scope(frame_arena &a)
+            : _M_prev(current())
+            { current() = &a; }
+
+            ~scope()
+            { current() = _M_prev; }
+
+            scope(const scope &) = delete;
+            scope& operator=(const scope &) = delete;
+        };
+    };
+
+    ///////////////////// basic_task
+
+    template <typename T, typename Native, template <typename, typename> class Heap>
+    class basic_task_thread;
+
+    template <typename T, typename Native, template <typename, typename> class Heap>
+    class basic_task
+    {
+    public:
+        typedef T clock_type;
+
+        struct promise_type
+        {
+            typedef T clock_type;
+
+            basic_task_thread<T, Native, Heap> * _M_thread;
+            typename T::cycles_type             _M_pending;     /* argument of run() */
+            typename T::cycles_type             _M_deadline;    /* set by the awaitables */
+
+            promise_type()
+            : _M_thread(), _M_pending(), _M_deadline()
+            {}
+
+            basic_task
+            get_return_object()
+            { return basic_task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+            std::suspend_always
+            initial_suspend() noexcept
+            { return {}; }
+
+            std::suspend_always
+            final_suspend() noexcept
+            { return {}; }
+
+            void
+            return_void()
+            {}
+
+            void
+            unhandled_exception()
+            { std::terminate(); }
+
+            // frames come from the current arena: the arena is stored in front of the frame.
+            //
+
+            static const std::size_t header = alignof(std::max_align_t);
+
+            static void *
+            operator new(std::size_t n)
+            {
+                frame_arena * a = frame_arena::current();
+                void * p = a ? a->allocate(n + header) : 0;
+                if (!p) {
+                    a = 0;
+                    p = ::operator new(n + header);
+                }
+                *static_cast<frame_arena **>(p) = a;
+                return static_cast<char *>(p) + header;
+            }
+
+            static void
+            operator delete(void *ptr, std::size_t n)
+            {
+                void * p = static_cast<char *>(ptr) - header;
+                frame_arena * a = *static_cast<frame_arena **>(p);
+                if (a)
+                    a->deallocate(p, n + header);
+                else
+                    ::operator delete(p);
+            }
+        };
+
+        typedef std::coroutine_handle<promise_type> handle_type;
+
+    private:
+        handle_type _M_coro;
+
+    public:
+        explicit basic_task(handle_type h = handle_type())
+        : _M_coro(h)
+        {}
+
+        ~basic_task()
+        {
+            if (_M_coro)
+                _M_coro.destroy();
+        }
+
+        basic_task(const basic_task &) = delete;
+        basic_task& operator=(const basic_task &) = delete;
+
+        basic_task(basic_task &&rhs) noexcept
+        : _M_coro(std::exchange(rhs._M_coro, handle_type()))
+        {}
+
+        basic_task& operator=(basic_task &&rhs) noexcept
+        {
+            if (this != &rhs) {
+                if (_M_coro)
+                    _M_coro.destroy();
+                _M_coro = std::exchange(rhs._M_coro, handle_type());
+            }
+            return *this;
+        }
+
+        handle_type
+        release()
+        { return std::exchange(_M_coro, handle_type()); }
+    };
+
+    ///////////////////// basic_task_thread: a basic_thread that resumes a task
+
+    template <typename T, typename Native, template <typename, typename> class Heap = qrt::random_access::vector_heap>
+    class basic_task_thread : public basic_thread<T, Native, Heap>
+    {
+    public:
+        typedef basic_task<T, Native, Heap>     task_type;
+        typedef typename task_type::handle_type handle_type;
+
+    private:
+        handle_type _M_coro;
+
+    public:
+        basic_task_thread(const typename T::cycles_type &b, const typename T::cycles_type &e, task_type &&t)
+        : basic_thread<T, Native, Heap>(b, e), _M_coro(t.release())
+        {
+            if (!_M_coro)
+                throw std::runtime_error("qrt::task_thread: empty task");
+            _M_coro.promise()._M_thread = this;
+        }
+
+        ~basic_task_thread()
+        {
+            if (_M_coro)
+                _M_coro.destroy();
+        }
+
+        // true if other threads are waiting in the heap of the scheduler...
+        //
+
+        bool
+        peers_pending() const
+        { return !this->_M_heap->empty(); }
+
+        typename T::cycles_type
+        run(typename T::cycles_type pending)
+        {
+            if (unlikely(!_M_coro))
+                return 0;
+
+            typename task_type::promise_type &p = _M_coro.promise();
+
+            if (unlikely(this->_M_state == 0)) {
+                this->_M_state = 1;
+                this->incr();
+            }
+
+            p._M_pending  = pending;
+            p._M_deadline = 0;
+
+            _M_coro.resume();
+
+            if (_M_coro.done()) {
+                _M_coro.destroy();
+                _M_coro = handle_type();
+                this->decr();
+                return 0;
+            }
+
+            return p._M_deadline;
+        }
+    };
+
+    ///////////////////// awaitables
+
+    // suspend for ticks cycles (from now), as qrt_sleep_for...
+    //
+
+    struct sleep_for
+    {
+        detail::cycles_t    _M_ticks;
+        detail::cycles_t    _M_deadline;
+        bool             (* _M_wait)(const detail::cycles_t &);
+
+        explicit sleep_for(detail::cycles_t ticks)
+        : _M_ticks(ticks), _M_deadline(), _M_wait()
+        {}
+
+        bool
+        await_ready() const noexcept
+        { return false; }
+
+        template <typename P>
+        void
+        await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            _M_deadline = P::clock_type::get_cycles() + _M_ticks;
+            _M_wait = &P::clock_type::busywait_until;
+            h.promise()._M_deadline = _M_deadline;
+        }
+
+        void
+        await_resume() const noexcept
+        { _M_wait(_M_deadline); }
+    };
+
+    // suspend until the deadline, as qrt_force_schedule...
+    //
+
+    struct until
+    {
+        detail::cycles_t    _M_deadline;
+        bool             (* _M_wait)(const detail::cycles_t &);
+
+        explicit until(detail::cycles_t deadline)
+        : _M_deadline(deadline), _M_wait()
+        {}
+
+        bool
+        await_ready() const noexcept
+        { return false; }
+
+        template <typename P>
+        void
+        await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            _M_wait = &P::clock_type::busywait_until;
+            h.promise()._M_deadline = _M_deadline;
+        }
+
+        void
+        await_resume() const noexcept
+        { _M_wait(_M_deadline); }
+    };
+
+    // suspend until the deadline only if other threads are pending in the
+    // heap and the deadline is later than the pending one, as qrt_schedule...
+    //
+
+    struct yield_if_pending
+    {
+        detail::cycles_t    _M_deadline;
+        bool             (* _M_wait)(const detail::cycles_t &);
+
+        explicit yield_if_pending(detail::cycles_t deadline)
+        : _M_deadline(deadline), _M_wait()
+        {}
+
+        bool
+        await_ready() const noexcept
+        { return false; }
+
+        template <typename P>
+        bool
+        await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            P &p = h.promise();
+            _M_wait = &P::clock_type::busywait_until;
+            if (unlikely(p._M_thread->peers_pending()) && (p._M_pending < _M_deadline)) {
+                p._M_deadline = _M_deadline;
+                return true;
+            }
+            return false;
+        }
+
+        void
+        await_resume() const noexcept
+        { _M_wait(_M_deadline); }
+    };
+
+#ifdef __linux__
+
+    typedef basic_task_thread<qrt::this_cpu, linux_native_thread, qrt::random_access::vector_heap> task_thread;
+
+#else
+
+    typedef basic_task_thread<qrt::this_cpu, null_native_thread, qrt::random_access::vector_heap> task_thread;
+
+#endif
+
+    typedef task_thread::task_type task;
+
+} // namespace qrt
+
+#endif /* _QRT_TASK_HPP_ */
@@ -25,9 +25,11 @@
 
 #include <qrt_coroutines.hpp>
 #include <qrt_scheduler.hpp>
+#include <qrt_lockfree.hpp>
 #include <qrt_utils.hpp>      
 
 #include <type_traits>
+#include <atomic>
 
 namespace qrt {
 
@@ -43,6 +45,10 @@ namespace qrt {
     public:
         typedef Heap< typename T::cycles_type, basic_thread *> heap_type;
         typedef typename T::cycles_type cycles_type;
+        typedef T clock_type;
+
+        template <typename, typename, template <typename, typename> class, typename>
+        friend struct scheduler_thread;
 
     protected:        
         static int &
@@ -67,18 +73,60 @@ namespace qrt {
               typename T::cycles_type _M_next;     /* next deadline */
               typename T::cycles_type _M_tstamp;   /* tstamp, used by sleep_for */
 
+        intrusive::pairing_hook<typename T::cycles_type, basic_thread *> _M_pairing;  /* intrusive heap links */
+        std::size_t _M_index;                      /* position in an indexed::heap */
+
         typename basic_scheduler<T, Native, Heap>::heap_type * _M_heap;
 
+        mpsc_hook<basic_thread> _M_link;           /* submission queue link */
+
+        std::atomic<seqlock<thread_stat<T> > *> _M_stat;  /* allocated and written by a stat_per_thread scheduler */
+
+        periodic_task<T> _M_task;                  /* timing model, for the admission control */
+        admission_state<T, basic_thread *> * _M_admission;     /* admitted by this scheduler */
+
+        int _M_priority;                           /* used by the priority:: heap policy (0 = highest) */
+
+        overrun _M_overrun;                        /* deadline-overrun policy */
+        unsigned _M_burst;                         /* late activations dispatched back-to-back (catch_up) */
+
+        int      _M_fd;                            /* fd to wait for (qrt_wait_fd), -1 if none */
+        unsigned _M_events;
+        unsigned _M_revents;
+
+        typename T::cycles_type _M_slack;          /* tolerated earliness of the next activation */
+
+        bool     _M_suspended;                     /* parked until wake() (qrt_wait_recv) */
+        mpsc_queue<basic_thread> * _M_wakeq;       /* submission queue of the last scheduler */
+
         basic_thread(const typename T::cycles_type &b, const typename T::cycles_type &e) 
         : _M_state(0), 
           _M_id(_S_id()), 
           _M_init(b), 
           _M_fini(e),
-          _M_next(b)
+          _M_next(b),
+          _M_tstamp(),
+          _M_pairing(),
+          _M_index(indexed::heap<typename T::cycles_type, basic_thread *>::npos),
+          _M_link(this),
+          _M_stat(0),
+          _M_task(),
+          _M_admission(),
+          _M_priority(0),
+          _M_overrun(),
+          _M_burst(0),
+          _M_fd(-1),
+          _M_events(0),
+          _M_revents(0),
+          _M_slack(0),
+          _M_suspended(false),
+          _M_wakeq()
         {}
 
         virtual ~basic_thread() 
-        {}
+        {
+            delete _M_stat.load(std::memory_order_relaxed);
+        }
 
         basic_thread(const basic_thread &) = delete;
         basic_thread& operator=(const basic_thread &) = delete;
@@ -124,6 +172,170 @@ namespace qrt {
         {
             _M_heap = &heap;            
         }
+
+        mpsc_hook<basic_thread> &
+        link()
+        { return _M_link; }
+
+        intrusive::pairing_hook<typename T::cycles_type, basic_thread *> &
+        pairing()
+        { return _M_pairing; }
+
+        std::size_t &
+        heap_index()
+        { return _M_index; }
+
+        // the per-thread stat is allocated only when the thread is scheduled
+        // by a stat_per_thread scheduler (before it is visible to it)...
+        //
+
+        void
+        alloc_stat()
+        {
+            if (!_M_stat.load(std::memory_order_relaxed))
+                _M_stat.store(new seqlock<thread_stat<T> >(), std::memory_order_release);
+        }
+
+        seqlock<thread_stat<T> > &
+        stat_seqlock()
+        { return * _M_stat.load(std::memory_order_relaxed); }
+
+        // periodic/sporadic model of the thread: set it before scheduling the
+        // thread, to submit it to the admission control of the scheduler...
+        //
+
+        const periodic_task<T> &
+        task() const
+        { return _M_task; }
+
+        void
+        task(const periodic_task<T> &value)
+        { _M_task = value; }
+
+        // the admission state of the scheduler that admitted the thread, if any...
+        //
+
+        admission_state<T, basic_thread *> *
+        admission() const
+        { return _M_admission; }
+
+        void
+        admission(admission_state<T, basic_thread *> *value)
+        { _M_admission = value; }
+
+        // fixed priority (0 = highest), see priority::basic_heap...
+        //
+
+        int
+        priority() const
+        { return _M_priority; }
+
+        void
+        priority(int value)
+        { _M_priority = value; }
+
+        // what to do when the next activation is already late, see overrun...
+        //
+
+        const overrun &
+        overrun_policy() const
+        { return _M_overrun; }
+
+        void
+        overrun_policy(const overrun &value)
+        { _M_overrun = value; }
+
+        // called by the scheduler with the overrun::degrade policy, when the
+        // deadline returned by run() is already past (now): switch to a cheaper
+        // mode and return the deadline of the next activation...
+        //
+
+        virtual typename T::cycles_type 
+        degrade(typename T::cycles_type deadline, typename T::cycles_type /* now */)
+        { return deadline; }
+
+        // readiness wait: the request is taken by the scheduler, that watches
+        // the fd by means of its event_source (see qrt_wait_fd)...
+        //
+
+        typename T::cycles_type
+        watch_fd(int fd, unsigned events)
+        {
+            _M_fd      = fd;
+            _M_events  = events;
+            _M_revents = 0;
+            return ~typename T::cycles_type();
+        }
+
+        int
+        watched_fd() const
+        { return _M_fd; }
+
+        unsigned
+        watched_events() const
+        { return _M_events; }
+
+        unsigned
+        revents() const
+        { return _M_revents; }
+
+        void
+        revents(unsigned value)
+        { _M_revents = value; }
+
+        // timer coalescing: the next activation may be dispatched up to slack
+        // cycles before the deadline, in a batch (see qrt_coalesce and 
+        // basic_scheduler::coalesce_window). Reset at every dispatch...
+        //
+
+        typename T::cycles_type
+        coalesce(typename T::cycles_type deadline, typename T::cycles_type slack)
+        {
+            _M_slack = slack;
+            return deadline;
+        }
+
+        typename T::cycles_type
+        slack() const
+        { return _M_slack; }
+
+        // suspension until wake(), called from any thread (see qrt_wait_recv).
+        // The scheduler parks the thread when run() returns, and makes it 
+        // eligible again when woken...
+        //
+
+        typename T::cycles_type
+        suspend()
+        {
+            _M_suspended = true;
+            return ~typename T::cycles_type();
+        }
+
+        bool
+        suspended() const
+        { return _M_suspended; }
+
+        void
+        resume()
+        { _M_suspended = false; }
+
+        void
+        wake()
+        { _M_wakeq->push(&_M_link); }
+
+        void
+        wake_queue(mpsc_queue<basic_thread> *queue)
+        { _M_wakeq = queue; }
+
+        // consistent snapshot of the per-thread stat, from any thread...
+        //
+
+        thread_stat<T>
+        stat() const
+        { 
+            const seqlock<thread_stat<T> > * s = _M_stat.load(std::memory_order_acquire);
+            return s ? s->load() : thread_stat<T>(); 
+        }
     
         virtual typename T::cycles_type run(typename T::cycles_type)=0;
     };
@@ -131,13 +343,22 @@ namespace qrt {
 #ifdef __linux__
 
     typedef basic_thread<qrt::this_cpu, linux_native_thread, qrt::random_access::vector_heap> thread; 
+    typedef basic_thread<qrt::this_cpu, linux_native_thread, qrt::priority::config<qrt::this_cpu>::heap> fp_thread; 
+    typedef basic_thread<qrt::this_cpu, linux_native_thread, qrt::indexed::heap> indexed_thread; 
 
 #else
     
     typedef basic_thread<qrt::this_cpu, null_native_thread, qrt::random_access::vector_heap> thread; 
+    typedef basic_thread<qrt::this_cpu, null_native_thread, qrt::priority::config<qrt::this_cpu>::heap> fp_thread; 
+    typedef basic_thread<qrt::this_cpu, null_native_thread, qrt::indexed::heap> indexed_thread; 
 
 #endif
 
+    typedef basic_thread<qrt::virtual_clock, null_native_thread, qrt::random_access::vector_heap> virtual_thread; 
+    typedef basic_thread<qrt::virtual_clock, null_native_thread, qrt::priority::config<qrt::virtual_clock>::heap> virtual_fp_thread; 
+
 }
 
+#include <qrt_group.hpp>
+
 #endif /* _QRT_THREAD_HPP_ */
@@ -0,0 +1,525 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _QRT_TOPOLOGY_HPP_
+#define _QRT_TOPOLOGY_HPP_
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace qrt {
+
+    ///////////////////// cpu_mask
+    //
+    // a set of cpus: a cpu_set_t on linux (native() is what sched_setaffinity
+    // and pthread_setaffinity_np take), a bitset elsewhere.
+
+    class cpu_mask
+    {
+#ifdef __linux__
+        cpu_set_t _M_set;
+#else
+        std::bitset<1024> _M_set;
+#endif
+
+    public:
+
+#ifdef __linux__
+        static const int max_cpus = CPU_SETSIZE;
+
+        cpu_mask()
+        { CPU_ZERO(&_M_set); }
+
+        explicit cpu_mask(const cpu_set_t &set)
+        : _M_set(set)
+        {}
+
+        const cpu_set_t &
+        native() const
+        { return _M_set; }
+
+        void
+        set(int n)
+        { if (n >= 0 && n < max_cpus) CPU_SET(n, &_M_set); }
+
+        void
+        reset(int n)
+        { if (n >= 0 && n < max_cpus) CPU_CLR(n, &_M_set); }
+
+        bool
+        test(int n) const
+        { return n >= 0 && n < max_cpus && CPU_ISSET(n, &_M_set); }
+
+        int
+        count() const
+        { return CPU_COUNT(&_M_set); }
+#else
+        static const int max_cpus = 1024;
+
+        cpu_mask()
+        : _M_set()
+        {}
+
+        void
+        set(int n)
+        { if (n >= 0 && n < max_cpus) _M_set.set(n); }
+
+        void
+        reset(int n)
+        { if (n >= 0 && n < max_cpus) _M_set.reset(n); }
+
+        bool
+        test(int n) const
+        { return n >= 0 && n < max_cpus && _M_set.test(n); }
+
+        int
+        count() const
+        { return static_cast<int>(_M_set.count()); }
+#endif
+        // the mask of a single cpu...
+        //
+
+        static cpu_mask
+        single(int n)
+        {
+            cpu_mask m;
+            m.set(n);
+            return m;
+        }
+
+        bool
+        empty() const
+        { return count() == 0; }
+
+        // the lowest cpu of the mask (-1 if empty)...
+        //
+
+        int
+        first() const
+        {
+            for(int n = 0; n < max_cpus; ++n)
+                if (test(n))
+                    return n;
+            return -1;
+        }
+
+        std::vector<int>
+        cpus() const
+        {
+            std::vector<int> ret;
+            for(int n = 0; n < max_cpus; ++n)
+                if (test(n))
+                    ret.push_back(n);
+            return ret;
+        }
+
+        cpu_mask &
+        operator|=(const cpu_mask &rhs)
+        {
+            for(int n : rhs.cpus())
+                set(n);
+            return *this;
+        }
+
+        // remove the cpus of rhs...
+        //
+
+        cpu_mask &
+        operator-=(const cpu_mask &rhs)
+        {
+            for(int n : rhs.cpus())
+                reset(n);
+            return *this;
+        }
+
+        bool
+        intersects(const cpu_mask &rhs) const
+        {
+            for(int n : rhs.cpus())
+                if (test(n))
+                    return true;
+            return false;
+        }
+
+        bool
+        operator==(const cpu_mask &rhs) const
+        { return cpus() == rhs.cpus(); }
+
+        bool
+        operator!=(const cpu_mask &rhs) const
+        { return !(*this == rhs); }
+
+        // parse a kernel cpu list, e.g. "0-3,8,10-11"...
+        //
+
+        static cpu_mask
+        parse(const std::string &list)
+        {
+            cpu_mask m;
+            std::istringstream in(list);
+            std::string item;
+
+            while (std::getline(in, item, ','))
+            {
+                item.erase(std::remove_if(item.begin(), item.end(), [](char c) { return c == ' ' || c == '\n' || c == '\t'; }), item.end());
+                if (item.empty())
+                    continue;
+
+                std::string::size_type dash = item.find('-');
+                try 
+                {
+                    int lo = std::stoi(item.substr(0, dash));
+                    int hi = dash == std::string::npos ? lo : std::stoi(item.substr(dash+1));
+                    for(int n = lo; n <= hi; ++n)
+                        m.set(n);
+                }
+                catch(std::logic_error &)
+                {
+                    throw std::runtime_error("qrt::cpu_mask: bad cpu list '" + list + "'");
+                }
+            }
+            return m;
+        }
+
+        std::string
+        to_string() const
+        {
+            std::ostringstream out;
+            std::vector<int> v = cpus();
+            for(std::size_t i = 0; i < v.size(); )
+            {
+                std::size_t j = i;
+                while (j + 1 < v.size() && v[j+1] == v[j] + 1)
+                    ++j;
+                if (i)
+                    out << ',';
+                out << v[i];
+                if (j > i)
+                    out << '-' << v[j];
+                i = j + 1;
+            }
+            return out.str();
+        }
+    };
+
+    ///////////////////// cpu_topology
+    //
+    // the cpus as seen by /sys/devices/system/cpu (or by a copy of it, given
+    // the root): package, core and SMT siblings, the cpus sharing the last
+    // level cache and the isolated/nohz_full lists of the kernel command line.
+    // Offline cpus are not listed. A snapshot: hotplug is not tracked.
+
+    struct cpu_info
+    {
+        int         id;
+        int         package;
+        int         core;
+        cpu_mask    siblings;   /* SMT siblings, the cpu included */
+        cpu_mask    llc;        /* cpus sharing the last level cache */
+        int         llc_level;
+        bool        isolated;
+        bool        nohz_full;
+    };
+
+    class cpu_topology
+    {
+        std::string             _M_root;
+        std::vector<cpu_info>   _M_cpus;
+        cpu_mask                _M_online;
+        cpu_mask                _M_isolated;
+        cpu_mask                _M_nohz_full;
+
+        // the content of a sysfs file (false if missing)...
+        //
+
+        bool
+        _M_read(const std::string &path, std::string &value) const
+        {
+            std::ifstream in((_M_root + "/" + path).c_str());
+            if (!in)
+                return false;
+            std::getline(in, value);
+            return true;
+        }
+
+        int
+        _M_read_int(const std::string &path, int def) const
+        {
+            std::string value;
+            if (!_M_read(path, value) || value.empty())
+                return def;
+            try 
+            {
+                return std::stoi(value);
+            }
+            catch(std::logic_error &)
+            {
+                return def;
+            }
+        }
+
+        cpu_mask
+        _M_read_mask(const std::string &path) const
+        {
+            std::string value;
+            return _M_read(path, value) ? cpu_mask::parse(value) : cpu_mask();
+        }
+
+        void
+        _M_discover()
+        {
+            std::string online;
+            if (!_M_read("online", online))
+                throw std::runtime_error("qrt::cpu_topology: cannot read " + _M_root + "/online");
+
+            _M_online    = cpu_mask::parse(online);
+            _M_isolated  = _M_read_mask("isolated");
+            _M_nohz_full = _M_read_mask("nohz_full");
+
+            cpu_mask offline = _M_offline();
+
+            for(int n : _M_online.cpus())
+            {
+                std::string cpu = "cpu" + std::to_string(n);
+
+                cpu_info info;
+                info.id       = n;
+                info.package  = _M_read_int(cpu + "/topology/physical_package_id", 0);
+                info.core     = _M_read_int(cpu + "/topology/core_id", n);
+
+                // core_cpus_list supersedes thread_siblings_list since linux 5.x...
+
+                info.siblings = _M_read_mask(cpu + "/topology/core_cpus_list");
+                if (info.siblings.empty())
+                    info.siblings = _M_read_mask(cpu + "/topology/thread_siblings_list");
+                if (info.siblings.empty())
+                    info.siblings.set(n);
+                info.siblings -= offline;
+
+                // the unified (or data) cache of the highest level...
+
+                info.llc_level = 0;
+                for(int i = 0; ; ++i)
+                {
+                    std::string index = cpu + "/cache/index" + std::to_string(i);
+                    std::string type;
+                    if (!_M_read(index + "/type", type))
+                        break;
+                    if (type == "Instruction")
+                        continue;
+                    int level = _M_read_int(index + "/level", 0);
+                    if (level > info.llc_level) {
+                        info.llc_level = level;
+                        info.llc = _M_read_mask(index + "/shared_cpu_list");
+                    }
+                }
+                if (info.llc.empty())
+                    info.llc = info.siblings;
+
+                info.isolated  = _M_isolated.test(n);
+                info.nohz_full = _M_nohz_full.test(n);
+
+                _M_cpus.push_back(info);
+            }
+        }
+
+        cpu_mask
+        _M_offline() const
+        {
+            cpu_mask m;
+            for(int n = 0; n < cpu_mask::max_cpus; ++n)
+                if (!_M_online.test(n))
+                    m.set(n);
+            return m;
+        }
+
+    public:
+        explicit cpu_topology(const std::string &root = "/sys/devices/system/cpu")
+        : _M_root(root), _M_cpus(), _M_online(), _M_isolated(), _M_nohz_full()
+        {
+            _M_discover();
+        }
+
+        std::size_t
+        size() const
+        { return _M_cpus.size(); }
+
+        const cpu_info &
+        operator[](std::size_t n) const
+        { return _M_cpus[n]; }
+
+        // the info of a cpu by id...
+        //
+
+        const cpu_info &
+        cpu(int id) const
+        {
+            for(const cpu_info &c : _M_cpus)
+                if (c.id == id)
+                    return c;
+            throw std::runtime_error("qrt::cpu_topology: cpu " + std::to_string(id) + " not online");
+        }
+
+        const cpu_mask &
+        online() const
+        { return _M_online; }
+
+        const cpu_mask &
+        isolated() const
+        { return _M_isolated; }
+
+        const cpu_mask &
+        nohz_full() const
+        { return _M_nohz_full; }
+
+        std::size_t
+        packages() const
+        {
+            std::vector<int> p;
+            for(const cpu_info &c : _M_cpus)
+                if (std::find(p.begin(), p.end(), c.package) == p.end())
+                    p.push_back(c.package);
+            return p.size();
+        }
+
+        // the physical cores (i.e. the sets of SMT siblings), by lowest cpu...
+        //
+
+        std::vector<cpu_mask>
+        cores() const
+        {
+            std::vector<cpu_mask> ret;
+            for(const cpu_info &c : _M_cpus)
+                if (std::find(ret.begin(), ret.end(), c.siblings) == ret.end())
+                    ret.push_back(c.siblings);
+            return ret;
+        }
+    };
+
+    ///////////////////// placement
+    //
+    // assign n schedulers to distinct physical cores, one cpu each:
+    //
+    // - the cores whose cpus are all isolated come first (nohz_full ones before
+    //   the others), then the rest; the core of cpu 0, which usually serves the
+    //   housekeeping and the interrupts, is the last resort
+    // - the cores that intersect exclude (e.g. the cpus handling the NIC irqs)
+    //   are never used
+    // - reserve_sibling: the SMT siblings of the chosen cpus are left idle 
+    //   (reserved); otherwise, once the cores are over, the siblings are used too
+    // - isolated_only: never fall back on non-isolated cores
+    //
+    // Throws if the schedulers do not fit.
+
+    struct placement
+    {
+        enum flags_t { none = 0, reserve_sibling = 1, isolated_only = 2 };
+
+        std::vector<cpu_mask>   cpus;       /* the affinity of each scheduler */
+        cpu_mask                reserved;   /* siblings to be kept idle */
+        cpu_mask                housekeeping; /* what is left for the other threads */
+    };
+
+    inline placement
+    place(const cpu_topology &topo, std::size_t n, int flags = placement::none, const cpu_mask &exclude = cpu_mask())
+    {
+        // rank the usable cores...
+
+        struct candidate 
+        {
+            cpu_mask    core;
+            int         rank;
+        };
+
+        std::vector<candidate> cand;
+        for(const cpu_mask &core : topo.cores())
+        {
+            if (core.intersects(exclude))
+                continue;
+
+            bool isolated = true, nohz = true;
+            for(int c : core.cpus()) {
+                isolated = isolated && topo.isolated().test(c);
+                nohz     = nohz && topo.nohz_full().test(c);
+            }
+
+            if (!isolated && (flags & placement::isolated_only))
+                continue;
+
+            candidate x = { core, isolated ? (nohz ? 0 : 1) : (core.test(0) ? 3 : 2) };
+            cand.push_back(x);
+        }
+
+        std::stable_sort(cand.begin(), cand.end(), [](const candidate &a, const candidate &b) { return a.rank < b.rank; });
+
+        placement ret;
+        cpu_mask used;
+
+        // one cpu per core, then (without reserve_sibling) the siblings...
+
+        for(std::size_t round = 0; ret.cpus.size() < n; ++round)
+        {
+            bool found = false;
+            for(const candidate &x : cand)
+            {
+                std::vector<int> cpus = x.core.cpus();
+                if (round >= cpus.size())
+                    continue;
+                found = true;
+                ret.cpus.push_back(cpu_mask::single(cpus[round]));
+                used.set(cpus[round]);
+                if (ret.cpus.size() == n)
+                    break;
+            }
+
+            if (!found || ((flags & placement::reserve_sibling) && ret.cpus.size() < n))
+                throw std::runtime_error("qrt::place: " + std::to_string(n) + " schedulers do not fit");
+        }
+
+        if (flags & placement::reserve_sibling)
+            for(const cpu_mask &c : ret.cpus)
+            {
+                cpu_mask s = topo.cpu(c.first()).siblings;
+                s -= used;
+                ret.reserved |= s;
+            }
+
+        ret.housekeeping = topo.online();
+        ret.housekeeping -= used;
+        ret.housekeeping -= ret.reserved;
+        ret.housekeeping -= topo.isolated();
+        return ret;
+    }
+
+} // namespace qrt
+
+#endif /* _QRT_TOPOLOGY_HPP_ */
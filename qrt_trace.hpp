@@ -0,0 +1,217 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef _QRT_TRACE_HPP_
+#define _QRT_TRACE_HPP_
+
+#include <qrt_utils.hpp>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace qrt {
+
+    ///////////////////// scheduling trace
+    //
+    // a per-scheduler ring of compact binary events stamped with the raw TSC,
+    // written by the scheduler thread only (single writer, no atomic RMW). The
+    // ring is an anonymous mapping or a shared mapping of a file: the latter
+    // lives in the page cache and survives a crash of the process.
+    //
+    // Layout: trace_header, then capacity trace_events. The events between
+    // max(0, head - capacity) and head are valid (the oldest are overwritten).
+    // tools/qrt_trace2json converts a trace file to Chrome/Perfetto JSON.
+
+    struct trace_event
+    {
+        enum type_t { 
+            add      = 1,   /* arg: first deadline */
+            dispatch = 2,   /* arg: deadline */
+            miss     = 3,   /* arg: lateness (cycles) */
+            ret      = 4,   /* arg: next deadline */
+            finish   = 5,   /* arg: 0 */
+            wake     = 6    /* arg: revents (readiness of qrt_wait_fd) */
+        };
+
+        uint64_t    tsc;
+        uint64_t    arg;
+        int32_t     id;     /* basic_thread::get_id() */
+        uint32_t    type;
+    };
+
+    struct trace_header
+    {
+        static const uint64_t magic_value = 0x4543415254545251ULL;   /* "QRTTRACE" */
+
+        uint64_t                magic;
+        uint32_t                version;
+        uint32_t                event_size;
+        uint64_t                capacity;
+        uint64_t                hz;         /* TSC rate (0 if unknown) */
+        int32_t                 sched;      /* user tag, e.g. the cpu of the scheduler */
+        uint32_t                pad0;
+        char                    pad1[cacheline_size - 40];
+        std::atomic<uint64_t>   head;       /* events written so far */
+        char                    pad2[cacheline_size - sizeof(std::atomic<uint64_t>)];
+    };
+
+    class trace_ring
+    {
+        trace_header *  _M_header;
+        trace_event *   _M_event;
+        std::size_t     _M_length;
+        uint64_t        _M_mask;
+        uint64_t        _M_head;    /* local copy of the head */
+
+        void
+        _M_init(void *p, std::size_t capacity, int sched)
+        {
+            _M_header = new (p) trace_header;
+            _M_event  = reinterpret_cast<trace_event *>(_M_header + 1);
+            _M_mask   = capacity - 1;
+
+            _M_header->magic      = trace_header::magic_value;
+            _M_header->version    = 1;
+            _M_header->event_size = sizeof(trace_event);
+            _M_header->capacity   = capacity;
+#if defined(__linux__) && defined(__x86_64__)
+            _M_header->hz         = tsc_clock::instance().cycles_per_sec();
+#else
+            _M_header->hz         = 0;
+#endif
+            _M_header->sched      = sched;
+            _M_header->head.store(0, std::memory_order_release);
+        }
+
+        static std::size_t
+        _S_length(std::size_t capacity)
+        {
+            if (capacity == 0 || (capacity & (capacity-1)))
+                throw std::runtime_error("qrt::trace_ring: capacity must be a power of 2");
+            return sizeof(trace_header) + capacity * sizeof(trace_event);
+        }
+
+    public:
+        // anonymous ring...
+        //
+
+        explicit trace_ring(std::size_t capacity, int sched = 0)
+        : _M_header(), _M_event(), _M_length(_S_length(capacity)), _M_mask(), _M_head(0)
+        {
+            void * p = ::mmap(0, _M_length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                throw std::runtime_error("mmap");
+            _M_init(p, capacity, sched);
+        }
+
+        // ring backed by a file (created or truncated)...
+        //
+
+        trace_ring(const char *path, std::size_t capacity, int sched = 0)
+        : _M_header(), _M_event(), _M_length(_S_length(capacity)), _M_mask(), _M_head(0)
+        {
+            int fd = ::open(path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+            if (fd < 0)
+                throw std::runtime_error("open");
+            if (::ftruncate(fd, static_cast<off_t>(_M_length)) != 0) {
+                ::close(fd);
+                throw std::runtime_error("ftruncate");
+            }
+            void * p = ::mmap(0, _M_length, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED)
+                throw std::runtime_error("mmap");
+            _M_init(p, capacity, sched);
+        }
+
+        ~trace_ring()
+        {
+            ::munmap(_M_header, _M_length);
+        }
+
+        trace_ring(const trace_ring &) = delete;
+        trace_ring& operator=(const trace_ring &) = delete;
+
+        // writer side (the scheduler thread)...
+        //
+
+        void
+        record(uint32_t type, int32_t id, uint64_t arg, uint64_t tsc)
+        {
+            trace_event &e = _M_event[_M_head & _M_mask];
+            e.tsc  = tsc;
+            e.arg  = arg;
+            e.id   = id;
+            e.type = type;
+            _M_header->head.store(++_M_head, std::memory_order_release);
+        }
+
+        void
+        record(uint32_t type, int32_t id, uint64_t arg)
+        {
+            record(type, id, arg, detail::get_cycles());
+        }
+
+        // in-process readers...
+        //
+
+        const trace_header &
+        header() const
+        { return *_M_header; }
+
+        std::size_t
+        capacity() const
+        { return static_cast<std::size_t>(_M_mask + 1); }
+
+        // events currently held by the ring...
+        //
+
+        std::size_t
+        size() const
+        {
+            uint64_t h = _M_header->head.load(std::memory_order_acquire);
+            return static_cast<std::size_t>(h < _M_mask + 1 ? h : _M_mask + 1);
+        }
+
+        // the n-th oldest event held...
+        //
+
+        const trace_event &
+        operator[](std::size_t n) const
+        {
+            uint64_t h = _M_header->head.load(std::memory_order_acquire);
+            return _M_event[(h - size() + n) & _M_mask];
+        }
+    };
+
+} // namespace qrt
+
+#endif /* _QRT_TRACE_HPP_ */
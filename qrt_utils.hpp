@@ -23,8 +23,28 @@
 #ifndef _QRT_UTIL_HPP_
 #define _QRT_UTIL_HPP_ 
 
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#endif
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
 namespace qrt {
 
+    // size of the cache line, used to pad data shared among cores
+    //
+
+    static const std::size_t cacheline_size = 64;
+
     // assembly policies are taken from the linux kernel 2.6/include/arch-.../
     //
  
@@ -64,14 +84,62 @@ namespace qrt {
                 return val;
             }
 #endif
+
+#if defined(__i386__) || defined(__x86_64__)
+            static inline void cpu_relax()
+            {
+                __asm__ __volatile__("pause" ::: "memory");
+            }
+#else
+            static inline void cpu_relax()
+            {
+                __asm__ __volatile__("" ::: "memory");
+            }
+#endif
     } // detail
 
-    // this_cpu implemented as policy class
+    // idle strategies: how busywait_until burns the time left before a deadline
+    //
+    //  spin     a bare loop on the timestamp counter (lowest wake-up latency)
+    //  pause    the same loop with a pause: leaves the pipeline to the SMT sibling 
+    //           and lowers the power of the spin
+    //  waitpkg  tpause (C0.1) on the cpus with WAITPKG, pause otherwise
+    //  hybrid   clock_nanosleep up to a guard band before the deadline, then pause
+    //
+ 
+    namespace idle 
+    {
+        struct spin
+        {
+            static inline void
+            wait_until(detail::cycles_t t)
+            {
+                while (detail::get_cycles() < t)
+                {}
+            }
+        };
+
+        struct pause
+        {
+            static inline void
+            wait_until(detail::cycles_t t)
+            {
+                while (detail::get_cycles() < t)
+                    detail::cpu_relax();
+            }
+        };
+
+    } // idle
+
+    // cpu timestamp counter implemented as policy class, parametrized by
+    // the idle strategy...
     //
 
-    struct this_cpu
+    template <typename Idle>
+    struct basic_cpu
     {
         typedef detail::cycles_t cycles_type;
+        typedef Idle             idle_type;
 
         static inline cycles_type 
         get_cycles()
@@ -79,13 +147,15 @@ namespace qrt {
             return detail::get_cycles();
         }
 
+        // returns false if the deadline is already expired
+        //
+
         static inline
         bool busywait_until(const cycles_type &t)
         {
             if (detail::get_cycles() >= t)
                 return false;
-            while (detail::get_cycles() < t)
-            {}
+            Idle::wait_until(t);
             return true;
         }
         
@@ -95,6 +165,336 @@ namespace qrt {
             return busywait_until(detail::get_cycles() + d);
         }
     }; 
+
+    typedef basic_cpu<idle::spin>   this_cpu;
+    typedef basic_cpu<idle::pause>  pause_cpu;
+
+    // virtual time implemented as policy class: busywait_until jumps straight 
+    // to the deadline, hence a scheduler replays hours of scheduling in seconds,
+    // deterministically and without RT privileges. Every get_cycles advances 
+    // the clock by Tick cycles (so that a loop polling the clock terminates), 
+    // and advance() models the execution time of a thread.
+    //
+    // The clock is global: one scheduler at a time (the Tag tells apart 
+    // independent clocks).
+
+    template <unsigned long Tick = 1, typename Tag = void>
+    struct basic_virtual_clock
+    {
+        typedef detail::cycles_t cycles_type;
+
+        static cycles_type &
+        now()
+        {
+            static cycles_type value;
+            return value;
+        }
+
+        static inline cycles_type 
+        get_cycles()
+        {
+            return now() += Tick;
+        }
+
+        static inline
+        bool busywait_until(const cycles_type &t)
+        {
+            if (get_cycles() >= t)
+                return false;
+            now() = t;
+            return true;
+        }
+        
+        static inline
+        bool busywait_for(const cycles_type &d)
+        {
+            return busywait_until(now() + d);
+        }
+
+        static void
+        advance(cycles_type d)
+        {
+            now() += d;
+        }
+
+        static void
+        reset(cycles_type t = 0)
+        {
+            now() = t;
+        }
+    };
+
+    typedef basic_virtual_clock<> virtual_clock;
+
+#if defined(__linux__) && defined(__x86_64__)
+
+    // tsc_clock: the TSC rate calibrated once against CLOCK_MONOTONIC_RAW (no 
+    // sysfs, no root). The cpufreq hardware frequency is unrelated to the TSC
+    // rate when the latter is invariant, which is the case of the cpus that 
+    // report it by CPUID (leaf 0x80000007, EDX bit 8).
+    //
+    // ns <-> cycles conversions are a 64x64 multiply and a shift by means of
+    // precomputed fixed-point factors (32.32), no division on the fast path.
+
+    class tsc_clock
+    {
+    public:
+        typedef detail::cycles_t cycles_type;
+
+        static const unsigned int shift = 32;
+
+    private:
+        uint64_t _M_hz;
+        uint64_t _M_ns2cyc;     /* cycles per ns, 32.32 */
+        uint64_t _M_cyc2ns;     /* ns per cycle,  32.32 */
+
+        static uint64_t
+        _S_ns(const struct timespec &ts)
+        { return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec); }
+
+        // sample the clocks, keeping the pair read in the narrowest tsc window...
+        //
+
+        static void
+        _S_sample(cycles_type &cyc, uint64_t &ns)
+        {
+            cycles_type best = ~cycles_type();
+            for(int i = 0; i < 8; ++i)
+            {
+                struct timespec ts;
+                cycles_type c0 = rdtsc_ordered();
+                ::clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+                cycles_type c1 = rdtsc_ordered();
+                if (c1 - c0 < best) {
+                    best = c1 - c0;
+                    cyc  = c0 + (c1 - c0)/2;
+                    ns   = _S_ns(ts);
+                }
+            }
+        }
+
+    public:
+        explicit tsc_clock(uint64_t calibration_ns = 20000000)
+        : _M_hz(), _M_ns2cyc(), _M_cyc2ns()
+        {
+            cycles_type c0 = 0, c1 = 0;
+            uint64_t n0 = 0, n1 = 0;
+
+            _S_sample(c0, n0);
+            struct timespec ts = { 0, static_cast<long>(calibration_ns) };
+            ::nanosleep(&ts, 0);
+            _S_sample(c1, n1);
+
+            if (n1 <= n0 || c1 <= c0)
+                throw std::runtime_error("qrt::tsc_clock: calibration failed");
+
+            _M_hz     = static_cast<uint64_t>(static_cast<unsigned __int128>(c1 - c0) * 1000000000ULL / (n1 - n0));
+            _M_ns2cyc = static_cast<uint64_t>((static_cast<unsigned __int128>(_M_hz) << shift) / 1000000000ULL);
+            _M_cyc2ns = static_cast<uint64_t>((static_cast<unsigned __int128>(1000000000ULL) << shift) / _M_hz);
+        }
+
+        // the calibrated clock of the process (calibrated at the first call)...
+        //
+
+        static const tsc_clock &
+        instance()
+        {
+            static const tsc_clock clock;
+            return clock;
+        }
+
+        // true if the TSC runs at constant rate in every P/C-state...
+        //
+
+        static bool
+        invariant()
+        {
+            unsigned int a, b, c, d;
+            if (!__get_cpuid(0x80000000, &a, &b, &c, &d) || a < 0x80000007)
+                return false;
+            __get_cpuid(0x80000007, &a, &b, &c, &d);
+            return (d & (1U << 8)) != 0;
+        }
+
+        // reads: raw (may be reordered with the surrounding code), ordered
+        // after the preceding loads (lfence;rdtsc), and rdtscp (waits for the
+        // preceding instructions and also returns the cpu id in aux)...
+        //
+
+        static inline cycles_type
+        get_cycles()
+        { return detail::get_cycles(); }
+
+        static inline cycles_type
+        rdtsc_ordered()
+        {
+            unsigned int a, d;
+            __asm__ __volatile__("lfence; rdtsc" : "=a" (a), "=d" (d) :: "memory");
+            return static_cast<cycles_type>(a) | (static_cast<cycles_type>(d) << 32);
+        }
+
+        static inline cycles_type
+        rdtscp(unsigned int *aux = 0)
+        {
+            unsigned int a, d, c;
+            __asm__ __volatile__("rdtscp" : "=a" (a), "=d" (d), "=c" (c) :: "memory");
+            if (aux)
+                *aux = c;
+            return static_cast<cycles_type>(a) | (static_cast<cycles_type>(d) << 32);
+        }
+
+        // TSC rate...
+        //
+
+        uint64_t
+        cycles_per_sec() const
+        { return _M_hz; }
+
+        // conversions...
+        //
+
+        cycles_type
+        from_ns(uint64_t ns) const
+        { return static_cast<cycles_type>((static_cast<unsigned __int128>(ns) * _M_ns2cyc) >> shift); }
+
+        cycles_type
+        from_us(uint64_t us) const
+        { return from_ns(us * 1000); }
+
+        cycles_type
+        from_ms(uint64_t ms) const
+        { return from_ns(ms * 1000000); }
+
+        uint64_t
+        to_ns(cycles_type cyc) const
+        { return static_cast<uint64_t>((static_cast<unsigned __int128>(cyc) * _M_cyc2ns) >> shift); }
+    };
+
+    namespace idle 
+    {
+        struct waitpkg
+        {
+            // CPUID.(EAX=7,ECX=0):ECX bit 5
+            //
+
+            static bool
+            available()
+            {
+                static const bool value = []() {
+                    unsigned int a, b, c, d;
+                    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+                        return false;
+                    return (c & (1U << 5)) != 0;
+                }();
+                return value;
+            }
+
+            // the OS caps each tpause (IA32_UMWAIT_CONTROL), hence the loop...
+            //
+
+            static inline void
+            wait_until(detail::cycles_t t)
+            {
+                if (!available())
+                    return pause::wait_until(t);
+
+                const unsigned int lo = static_cast<unsigned int>(t);
+                const unsigned int hi = static_cast<unsigned int>(t >> 32);
+
+                while (detail::get_cycles() < t)
+                {
+                    /* tpause %ecx (ecx = 1: C0.1, the faster wake-up) */
+                    __asm__ __volatile__(".byte 0x66, 0x0f, 0xae, 0xf1" 
+                                         :: "c" (1), "a" (lo), "d" (hi) : "cc", "memory");
+                }
+            }
+        };
+
+        // the guard band absorbs the timer slack and the wake-up latency of the 
+        // kernel: set it above the worst wake-up latency of the machine (and use
+        // a RT policy, as the default timer slack of SCHED_OTHER is 50us). The
+        // tsc_clock is calibrated at the first call: call tsc_clock::instance() 
+        // before starting the schedulers.
+        //
+
+        template <unsigned long GuardNs = 50000>
+        struct hybrid
+        {
+            static const unsigned long guard_ns = GuardNs;
+
+            static void
+            wait_until(detail::cycles_t t)
+            {
+                const tsc_clock &clock = tsc_clock::instance();
+                const detail::cycles_t guard = clock.from_ns(GuardNs);
+
+                detail::cycles_t now = detail::get_cycles();
+                if (now + guard < t)
+                {
+                    struct timespec ts;
+                    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+
+                    uint64_t ns = static_cast<uint64_t>(ts.tv_nsec) + clock.to_ns(t - now - guard);
+                    ts.tv_sec  += static_cast<time_t>(ns / 1000000000ULL);
+                    ts.tv_nsec  = static_cast<long>(ns % 1000000000ULL);
+
+                    while (::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) == EINTR)
+                    {}
+                }
+
+                pause::wait_until(t);
+            }
+        };
+
+    } // idle
+
+    typedef basic_cpu<idle::waitpkg>    waitpkg_cpu;
+    typedef basic_cpu<idle::hybrid<> >  hybrid_cpu;
+
+#endif
+
+    // memory prefaulted and locked by a scheduler when it starts (see
+    // basic_scheduler::lock_at_start), e.g. a stack_pool...
+    //
+
+    struct lockable_memory
+    {
+        virtual ~lockable_memory()
+        {}
+
+        virtual void lock() = 0;
+    };
+
+#ifdef __linux__
+
+    // touch every page of an object (e.g. a scheduler with a static_heap) and lock 
+    // it in RAM, before the RT threads start...
+    //
+
+    inline void
+    prefault_and_lock(void *addr, std::size_t len)
+    {
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        volatile char * p = static_cast<volatile char *>(addr);
+
+        for(std::size_t off = 0; off < len; off += page)
+            p[off] = p[off];
+        if (len)
+            p[len-1] = p[len-1];
+
+        if (::mlock(addr, len) != 0)
+            throw std::runtime_error("mlock");
+    }
+
+    template <typename Tp>
+    inline void
+    prefault_and_lock(Tp &obj)
+    {
+        prefault_and_lock(static_cast<void *>(&obj), sizeof(Tp));
+    }
+
+#endif
+
 } // namespace qrt
 
 #endif /* _QRT_UTIL_HPP_ */
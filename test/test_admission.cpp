@@ -0,0 +1,135 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_thread.hpp>
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+// admission control of periodic threads, in virtual time...
+// 
+
+typedef qrt::periodic_task<qrt::virtual_clock> model;
+
+struct mythread : public qrt::virtual_thread
+{
+    qrt::virtual_clock::cycles_type _M_ts;
+
+public:
+    mythread(const model &t)
+    : qrt::virtual_thread(0, 100 * t.period), _M_ts()
+    { this->task(t); }
+
+    qrt::virtual_clock::cycles_type 
+    run(qrt::virtual_clock::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(_M_ts = this->begin(); _M_ts < this->end(); )
+        {
+            qrt::virtual_clock::advance(this->task().wcet);
+            _M_ts += this->task().period;
+            qrt_force_schedule(_M_ts);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+int errors;
+
+void
+expect(qrt::virtual_scheduler &s, std::vector<mythread *> &ts, const model &t, bool admitted, const char *what)
+{
+    mythread * th = new mythread(t);
+    bool ok = true;
+    try {
+        s(th);
+        ts.push_back(th);
+    }
+    catch(std::runtime_error &) {
+        ok = false;
+        delete th;
+    }
+
+    std::cerr << what << ": " << (ok ? "admitted" : "rejected") << " (U = " << s.utilization() << ")" << std::endl;
+    if (ok != admitted) {
+        std::cerr << "    FAILED" << std::endl;
+        errors++;
+    }
+}
+
+int
+main(int, char *[])
+{
+    std::vector<mythread *> ts;
+
+    // implicit deadlines: U <= 1
+
+    {
+        qrt::virtual_scheduler s;
+        expect(s, ts, model(4, 1), true,  "C=1 P=4");
+        expect(s, ts, model(4, 2), true,  "C=2 P=4");
+        expect(s, ts, model(2, 1), false, "C=1 P=2");
+        expect(s, ts, model(8, 2), true,  "C=2 P=8");
+        expect(s, ts, model(8, 1), false, "C=1 P=8");
+        s.join();
+    }
+
+    // constrained deadlines: the density exceeds 1, the demand does not...
+
+    {
+        qrt::virtual_scheduler s;
+        expect(s, ts, model(10, 2, 3), true,  "C=2 D=3 P=10");
+        expect(s, ts, model(10, 2, 4), true,  "C=2 D=4 P=10");
+        expect(s, ts, model(10, 1, 4), false, "C=1 D=4 P=10");
+        expect(s, ts, model(10, 1, 6), true,  "C=1 D=6 P=10");
+        expect(s, ts, model(3,  1, 2), false, "C=1 D=2 P=3");
+        expect(s, ts, model(20, 1, 2), false, "C=1 D=2 P=20");
+    }
+
+    // capped utilization, and release at the end of the threads...
+
+    {
+        qrt::virtual_scheduler s;
+        s.utilization_cap(0.5);
+        expect(s, ts, model(4, 1), true,  "cap 0.5, C=1 P=4");
+        expect(s, ts, model(4, 1), true,  "cap 0.5, C=1 P=4");
+        expect(s, ts, model(100, 1), false, "cap 0.5, C=1 P=100");
+
+        s.start();
+        s.join();
+
+        if (s.utilization() > 1e-9) {
+            std::cerr << "utilization not released: " << s.utilization() << std::endl;
+            errors++;
+        }
+        expect(s, ts, model(4, 2), true,  "cap 0.5 (after), C=2 P=4");
+    }
+
+    for(mythread * t : ts)
+        delete t;
+
+    return errors != 0;
+}
@@ -0,0 +1,132 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_thread.hpp>
+
+#include <iostream>
+#include <stdexcept>
+
+// a scheduler on a heap of 2 threads, with both the overflow_reject and the
+// overflow_throw policies: the third thread (with a periodic model) is refused
+// by operator() and its utilization released, the ones submitted while the
+// heap is full are retired and counted as dropped, in virtual time.
+//
+
+static const qrt::virtual_clock::cycles_type period = 1000;
+
+template <typename Overflow>
+struct bounded
+{
+    template <typename K, typename V>
+    struct heap : public qrt::random_access::static_heap<K, V, 2, Overflow> {};
+
+    typedef qrt::basic_thread<qrt::virtual_clock, qrt::null_native_thread, heap> thread_type;
+    typedef qrt::basic_scheduler<qrt::virtual_clock, qrt::null_native_thread, heap, qrt::stat_enabled> scheduler;
+
+    struct periodic : public thread_type
+    {
+        scheduler * _M_sched;
+        thread_type * _M_spawn[2];
+        int _M_n;
+
+        typedef qrt::virtual_clock clock_type;
+        using thread_type::_M_state;
+        using thread_type::_M_tstamp;
+
+    public:
+        periodic(qrt::virtual_clock::cycles_type b, qrt::virtual_clock::cycles_type e, scheduler *s = 0)
+        : thread_type(b,e), _M_sched(s), _M_spawn(), _M_n(0)
+        {}
+
+        qrt::virtual_clock::cycles_type 
+        run(qrt::virtual_clock::cycles_type)
+        {
+            qrt_context_begin;
+
+            while (this->next_deadline() < this->end()) 
+            {
+                if (_M_sched && _M_n == 1) {
+                    _M_sched->submit(_M_spawn[0]);
+                    _M_sched->submit(_M_spawn[1]);
+                }
+                _M_n++;
+                qrt_next_period(period);
+            }
+
+            qrt_context_end;
+        }    
+    };
+};
+
+
+template <typename Overflow>
+bool
+replay(const char *name)
+{
+    typedef typename bounded<Overflow>::periodic periodic;
+
+    qrt::virtual_clock::reset();
+
+    typename bounded<Overflow>::scheduler sched0;
+
+    periodic a(period, 10 * period, &sched0), b(period, 10 * period);
+    periodic c(period, 10 * period), d(period, 10 * period), e(period, 10 * period);
+
+    a._M_spawn[0] = &d;
+    a._M_spawn[1] = &e;
+    c.task(qrt::periodic_task<qrt::virtual_clock>(period, period / 10));
+
+    sched0(&a);
+    sched0(&b);
+
+    bool refused = false;
+    try 
+    {
+        sched0(&c);
+    }
+    catch(std::runtime_error &)
+    {
+        refused = true;
+    }
+
+    bool released = sched0.utilization() < 1e-9;
+
+    sched0.start();
+    sched0.join();
+
+    bool ok = refused && released && a._M_n == 9 && b._M_n == 9 && 
+              c._M_n == 0 && d._M_n == 0 && e._M_n == 0 && sched0.stat().dropped == 2;
+
+    std::cerr << name << ": refused: " << refused << ", released: " << released << ", dropped: " << sched0.stat().dropped 
+              << (ok ? ": ok" : ": FAILED") << std::endl;
+    return ok;
+}
+
+
+int
+main(int, char *[])
+{
+    bool ok = replay<qrt::random_access::overflow_reject>("overflow_reject");
+    ok = replay<qrt::random_access::overflow_throw>("overflow_throw") && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <qrt_thread.hpp>
+
+#include <iostream>
+#include <vector>
+
+// cancel and reschedule threads queued in an indexed heap, in virtual time.
+//
+
+typedef qrt::basic_thread<qrt::virtual_clock, qrt::null_native_thread, qrt::indexed::heap> thread_type;
+typedef qrt::basic_scheduler<qrt::virtual_clock, qrt::null_native_thread, qrt::indexed::heap> scheduler;
+
+static const qrt::virtual_clock::cycles_type period = 1000;
+
+struct periodic : public thread_type
+{
+    std::vector<qrt::virtual_clock::cycles_type> _M_dispatch;
+
+public:
+    periodic(qrt::virtual_clock::cycles_type b, qrt::virtual_clock::cycles_type e)
+    : thread_type(b,e), _M_dispatch()
+    {}
+
+    qrt::virtual_clock::cycles_type 
+    run(qrt::virtual_clock::cycles_type)
+    {
+        qrt_context_begin;
+
+        while (this->next_deadline() < this->end()) 
+        {
+            _M_dispatch.push_back(qrt::virtual_clock::now());
+            qrt_next_period(period);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+struct controller : public thread_type
+{
+    scheduler & _M_sched;
+    periodic  & _M_victim;
+    periodic  & _M_moved;
+    bool        _M_result[3];
+
+public:
+    controller(scheduler &s, periodic &v, periodic &m, qrt::virtual_clock::cycles_type b)
+    : thread_type(b, b + 1), _M_sched(s), _M_victim(v), _M_moved(m), _M_result()
+    {}
+
+    qrt::virtual_clock::cycles_type 
+    run(qrt::virtual_clock::cycles_type)
+    {
+        qrt_context_begin;
+
+        qrt::virtual_clock::busywait_until(this->begin());
+
+        _M_result[0] = _M_sched.cancel(&_M_victim);
+        _M_result[1] = _M_sched.reschedule(&_M_moved, 10 * period);
+        _M_result[2] = !_M_sched.cancel(this);      /* running, not queued */
+
+        qrt_context_end;
+    }    
+};
+
+
+int
+main(int, char *[])
+{
+    qrt::virtual_clock::reset();
+
+    scheduler sched0;
+
+    periodic victim(period, 100 * period);
+    periodic moved(period, 12 * period);
+    controller ctrl(sched0, victim, moved, 3 * period + period / 2);
+
+    sched0(&victim);
+    sched0(&moved);
+    sched0(&ctrl);
+
+    sched0.start();
+    sched0.join();
+
+    // victim: 1000, 2000, 3000 then cancelled; moved: 1000, 2000, 3000, then 10000, 11000
+
+    bool ok = ctrl._M_result[0] && ctrl._M_result[1] && ctrl._M_result[2] &&
+              victim._M_dispatch.size() == 3 && 
+              moved._M_dispatch.size() == 5 && moved._M_dispatch[3] == 10 * period;
+
+    std::cerr << "victim: " << victim._M_dispatch.size() << " activations, moved:";
+    for(auto t : moved._M_dispatch)
+        std::cerr << ' ' << t;
+    std::cerr << (ok ? ": ok" : ": FAILED") << std::endl;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <qrt_thread.hpp>
+#include <qrt_channel.hpp>
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+// a pipeline across three schedulers: source -> (spsc) -> stage -> (mpsc) -> sink,
+// with a second producer feeding the mpsc channel. The consumers are suspended
+// by qrt_wait_recv while their channel is empty.
+//
+
+static long items;
+
+static qrt::spsc_channel<long, 256> stage_in;
+static qrt::mpsc_channel<long, 256> sink_in;
+
+static std::atomic<int> producers(2);   /* of sink_in */
+
+static void
+producer_done()
+{
+    if (--producers == 0)
+        sink_in.close();
+}
+
+
+struct source : public qrt::thread
+{
+    long _M_n;
+
+public:
+    source()
+    : qrt::thread(qrt::this_cpu::get_cycles(), ~qrt::this_cpu::cycles_type()), _M_n()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(; _M_n < items; ++_M_n)
+        {
+            while (!stage_in.send(_M_n))
+                qrt_force_schedule(qrt::this_cpu::get_cycles());   // full: back off
+        }
+
+        stage_in.close();
+        qrt_context_end;
+    }    
+};
+
+
+struct stage : public qrt::thread
+{
+    long _M_buf[32];
+    std::size_t _M_n, _M_i;
+
+public:
+    stage()
+    : qrt::thread(qrt::this_cpu::get_cycles(), ~qrt::this_cpu::cycles_type()), _M_buf(), _M_n(), _M_i()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(;;)
+        {
+            qrt_wait_recv(stage_in);
+
+            _M_n = stage_in.try_recv_n(_M_buf, 32);
+            if (!_M_n && stage_in.closed() && stage_in.size() == 0)
+                break;
+
+            for(_M_i = 0; _M_i < _M_n; ++_M_i)
+                _M_buf[_M_i] *= 2;
+
+            for(_M_i = 0; _M_i < _M_n; )
+            {
+                _M_i += sink_in.send_n(_M_buf + _M_i, _M_n - _M_i);
+                if (_M_i < _M_n)
+                    qrt_force_schedule(qrt::this_cpu::get_cycles());
+            }
+        }
+
+        producer_done();
+        qrt_context_end;
+    }    
+};
+
+
+struct odd : public qrt::thread
+{
+    long _M_n;
+
+public:
+    odd()
+    : qrt::thread(qrt::this_cpu::get_cycles(), ~qrt::this_cpu::cycles_type()), _M_n()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(; _M_n < items; ++_M_n)
+        {
+            while (!sink_in.send(2 * _M_n + 1))
+                qrt_force_schedule(qrt::this_cpu::get_cycles());
+        }
+
+        producer_done();
+        qrt_context_end;
+    }    
+};
+
+
+struct sink : public qrt::thread
+{
+    long _M_buf[64];
+    long _M_count;
+    long _M_sum;
+    int  _M_wait;
+
+public:
+    sink()
+    : qrt::thread(qrt::this_cpu::get_cycles(), ~qrt::this_cpu::cycles_type()), _M_buf(), _M_count(), _M_sum(), _M_wait()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(;;)
+        {
+            if (sink_in.size() == 0)
+                _M_wait++;
+
+            qrt_wait_recv(sink_in);
+
+            {
+                std::size_t n = sink_in.try_recv_n(_M_buf, 64);
+                if (!n && sink_in.closed() && sink_in.size() == 0)
+                    break;
+
+                for(std::size_t i = 0; i < n; ++i)
+                    _M_sum += _M_buf[i];
+                _M_count += n;
+            }
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+int
+main(int argc, char *argv[])
+{
+    items = argc > 1 ? atol(argv[1]) : 100000;
+
+    qrt::deadline_scheduler a, b, c;
+
+    source src; stage stg; odd o; sink snk;
+
+    a(&src);
+    b(&stg);
+    b(&o);
+    c(&snk);
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+    c.start(); b.start(); a.start();
+    a.join(); b.join(); c.join();
+
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    // 2*(0+1+..+items-1) + (1+3+..+2*items-1) = items*(items-1) + items^2 
+
+    long expect = items * (items - 1) + items * items;
+    bool ok = snk._M_count == 2 * items && snk._M_sum == expect;
+
+    std::cerr << snk._M_count << " values in " << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() 
+              << " ms, sink found the channel empty " << snk._M_wait << " times: " << (ok ? "ok" : "FAILED") << std::endl;
+
+    return ok ? 0 : 1;
+}
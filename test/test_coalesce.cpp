@@ -0,0 +1,122 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <qrt_thread.hpp>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+// pacing flows with staggered phases, that tolerate an early activation:
+// with a coalescing window the scheduler dispatches them in batches, never 
+// earlier than their slack, in virtual time. The per-thread exec time of the
+// early activations must not wrap around, and a flow queued before its
+// begin() must not start earlier, even within a batch.
+//
+
+typedef qrt::basic_scheduler<qrt::virtual_clock, qrt::null_native_thread, qrt::random_access::vector_heap, qrt::stat_per_thread> scheduler;
+
+static const qrt::virtual_clock::cycles_type period = 1000;
+static const qrt::virtual_clock::cycles_type tolerance = 50;
+
+struct flow : public qrt::virtual_thread
+{
+    qrt::virtual_clock::cycles_type _M_ts;
+    qrt::virtual_clock::cycles_type _M_early;   /* max earliness */
+    qrt::virtual_clock::cycles_type _M_start;   /* first activation */
+    long _M_n;
+
+public:
+    flow(qrt::virtual_clock::cycles_type b, qrt::virtual_clock::cycles_type e)
+    : qrt::virtual_thread(b,e), _M_ts(), _M_early(), _M_start(), _M_n()
+    {}
+
+    qrt::virtual_clock::cycles_type 
+    run(qrt::virtual_clock::cycles_type)
+    {
+        qrt_context_begin;
+
+        _M_start = qrt::virtual_clock::now();
+
+        for(_M_ts = this->begin(); _M_ts < this->end(); ++_M_n)
+        {
+            _M_ts += period;
+            qrt_coalesce(_M_ts, tolerance);
+
+            if (qrt::virtual_clock::now() < _M_ts)
+                _M_early = std::max(_M_early, _M_ts - qrt::virtual_clock::now());
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+bool
+replay(qrt::virtual_clock::cycles_type window)
+{
+    qrt::virtual_clock::reset();
+
+    scheduler sched0;
+    std::vector<flow *> flows;
+
+    sched0.coalesce_window(window);
+
+    for(int i = 0; i < 100; ++i)
+    {
+        flows.push_back(new flow(period + i * 10, 100 * period));
+        sched0(flows.back());
+    }
+
+    // queued along with the first flow, 5 periods before its begin()...
+
+    flows.push_back(new flow(6 * period, 100 * period));
+    sched0(flows.back(), period);
+
+    sched0.start();
+    sched0.join();
+
+    long n = 0;
+    qrt::virtual_clock::cycles_type early = 0, wcet = 0;
+    bool started = true;
+    for(flow * f : flows)
+    {
+        started = started && f->_M_start >= f->begin();
+        n += f->_M_n;
+        early = std::max(early, f->_M_early);
+        wcet  = std::max(wcet, f->stat().wcet);
+        delete f;
+    }
+
+    const int batch = sched0.stat().batch;
+
+    std::cerr << "window " << window << ": " << n << " activations, " << batch << " batches, max earliness " << early 
+              << ", wcet " << wcet << (started ? "" : ", started before begin()") << std::endl;
+
+    return n > 0 && started && early <= tolerance && wcet < period && (window ? batch * 4 < n && early > 0 : batch == 0);
+}
+
+
+int
+main(int, char *[])
+{
+    return replay(0) && replay(tolerance) ? 0 : 1;
+}
@@ -22,11 +22,14 @@
 
 #include <qrt_cpufreq.hpp>
 #include <qrt_thread.hpp>
+#include <qrt_context.hpp>
 
 #include <sys/mman.h>
 #include <iostream>
+#include <string>
 
-// this test measures the cost of context switch in timestamp counters 
+// this test measures the cost of context switch in timestamp counters,
+// for the stackless threads (default) and the stackful ones 
 // 
 
 qrt::this_cpu::cycles_type ts_beg;
@@ -52,7 +55,7 @@ public:
     {
         qrt_context_begin;
 
-        inter_time = qrt::cpufreq(0).freq_hardware() * 1000/_M_rate;
+        inter_time = qrt::tsc_clock::instance().cycles_per_sec()/_M_rate;
 
         for( ts = qrt::this_cpu::get_cycles(); qrt::this_cpu::get_cycles() < this->end() ; )
         {
@@ -73,19 +76,64 @@ public:
 };
 
 
+// the same thread, stackful: the switch happens in a nested call...
+
+struct mythread_stackful : public qrt::stackful_thread
+{
+    int _M_rate;
+
+    qrt::this_cpu::cycles_type inter_time;
+
+public:
+    mythread_stackful(qrt::this_cpu::cycles_type b, qrt::this_cpu::cycles_type e, int r)
+    : qrt::stackful_thread(b,e),
+      _M_rate(r)
+    {}
+
+    void 
+    wait(qrt::this_cpu::cycles_type ts)
+    {
+        ts_beg = qrt::this_cpu::get_cycles();
+        this->context_switch(ts);
+        ts_end = qrt::this_cpu::get_cycles();
+    }
+
+    // thread body...
+
+    void 
+    main()
+    {
+        inter_time = qrt::tsc_clock::instance().cycles_per_sec()/_M_rate;
+
+        for(qrt::this_cpu::cycles_type ts = qrt::this_cpu::get_cycles(); qrt::this_cpu::get_cycles() < this->end() ; )
+        {
+            ts += inter_time;
+
+            wait(ts);
+
+            printf("%llu\n", ts_end-ts_beg);
+            qrt::this_cpu::busywait_until(ts);
+        }
+
+        ts_beg = qrt::this_cpu::get_cycles();
+    }    
+};
+
+
 int
 main(int argc, char *argv[])
 {
     if (argc < 3) {
-        std::cerr << "usage: threads rate" << std::endl;
+        std::cerr << "usage: threads rate [stackful]" << std::endl;
         exit(1);
     }
     
     int nthread = atoi(argv[1]);
     int rate    = atoi(argv[2]);
+    bool stackful = argc > 3 && std::string(argv[3]) == "stackful";
 
     qrt::cpufreq(0).set_policy_governor("performance");
-    qrt::this_cpu::cycles_type sec = qrt::cpufreq(0).freq_hardware() * 1000;
+    qrt::this_cpu::cycles_type sec = qrt::tsc_clock::instance().cycles_per_sec();
 
     qrt::stat_deadline_scheduler sched0;
 
@@ -94,7 +142,11 @@ main(int argc, char *argv[])
 
     for(int i = 0; i < nthread; ++i ) 
     {
-        mythread * t = new mythread(qrt::this_cpu::get_cycles(), qrt::this_cpu::get_cycles() + sec * 5, rate);
+        qrt::thread * t;
+        if (stackful)
+            t = new mythread_stackful(qrt::this_cpu::get_cycles(), qrt::this_cpu::get_cycles() + sec * 5, rate);
+        else
+            t = new mythread(qrt::this_cpu::get_cycles(), qrt::this_cpu::get_cycles() + sec * 5, rate);
         sched0(t);        
     }
 
@@ -0,0 +1,172 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_thread.hpp>
+
+#include <iostream>
+#include <vector>
+
+// fixed-priority dispatch in virtual time: a blocker makes two threads ready
+// at once, the high priority one must run first even if the low priority one
+// was released earlier. Then three threads released at the same instants (a
+// harmonic task set), dispatched by priority. Then a thread pushed after the
+// heap looked at the next (unreleased) one, but released earlier: it must come
+// first. Then the response-time analysis...
+// 
+
+typedef qrt::virtual_clock::cycles_type cycles_type;
+
+static const cycles_type period = 1000000;
+
+std::vector<int> order;
+
+struct mythread : public qrt::virtual_fp_thread
+{
+    int          _M_tag;
+    cycles_type  _M_offset;
+    cycles_type  _M_work;
+    cycles_type  _M_ts;
+
+public:
+    mythread(int tag, int prio, cycles_type offset, cycles_type work)
+    : qrt::virtual_fp_thread(period + offset, 100 * period), _M_tag(tag), _M_offset(offset), _M_work(work), _M_ts()
+    { this->priority(prio); }
+
+    cycles_type 
+    run(cycles_type)
+    {
+        qrt_context_begin;
+
+        for(_M_ts = this->begin(); _M_ts < this->end(); )
+        {
+            order.push_back(_M_tag);
+            qrt::virtual_clock::advance(_M_work);
+
+            _M_ts += period;
+            qrt_force_schedule(_M_ts);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+int
+main(int, char *[])
+{
+    int errors = 0;
+
+    qrt::virtual_clock::reset();
+
+    mythread blocker(0, 0, 0, 20000);
+    mythread low    (2, 9, 5000, 1000);     // released first...
+    mythread high   (1, 1, 8000, 1000);     // ...but of higher priority
+
+    qrt::virtual_fp_scheduler s;
+    s(&blocker);
+    s(&low);
+    s(&high);
+    s.start();
+    s.join();
+
+    for(std::size_t i = 0; i + 2 < order.size(); i += 3)
+    {
+        if (order[i] != 0 || order[i+1] != 1 || order[i+2] != 2) {
+            std::cerr << "wrong dispatch order at activation " << i/3 << ": " 
+                      << order[i] << order[i+1] << order[i+2] << std::endl;
+            errors++;
+            break;
+        }
+    }
+    std::cerr << order.size() << " dispatches, priority order " << (errors ? "FAILED" : "ok") << std::endl;
+
+    // same release instants, scheduled from the lowest priority...
+
+    qrt::virtual_clock::reset();
+    order.clear();
+
+    {
+        mythread low (2, 9, 0, 1000);
+        mythread mid (3, 5, 0, 1000);
+        mythread high(1, 1, 0, 1000);
+
+        qrt::virtual_fp_scheduler s;
+        s(&low);
+        s(&mid);
+        s(&high);
+        s.start();
+        s.join();
+    }
+
+    int tie = 0;
+    for(std::size_t i = 0; i + 2 < order.size(); i += 3)
+    {
+        if (order[i] != 1 || order[i+1] != 3 || order[i+2] != 2) {
+            std::cerr << "wrong dispatch order at release " << i/3 << ": " 
+                      << order[i] << order[i+1] << order[i+2] << std::endl;
+            tie++;
+            break;
+        }
+    }
+    std::cerr << order.size() << " dispatches, same release " << (tie || order.size() != 3 * 99 ? "FAILED" : "ok") << std::endl;
+    errors += tie || order.size() != 3 * 99;
+
+    // an earlier release pushed after top()...
+
+    qrt::virtual_clock::reset();
+
+    {
+        mythread late (4, 0, 0, 0);
+        mythread early(5, 5, 0, 0);
+
+        qrt::priority::config<qrt::virtual_clock>::heap<cycles_type, qrt::virtual_fp_thread *> h;
+        h.push(1000, &late);
+        h.top();
+        h.push(10, &early);
+        qrt::virtual_clock::advance(22);
+
+        bool ok = h.top().first == 10 && h.pop().second == &early && h.pop().second == &late && h.empty();
+        std::cerr << "earlier release after top(): " << (ok ? "ok" : "FAILED") << std::endl;
+        errors += !ok;
+    }
+
+    // response-time analysis...
+
+    typedef qrt::periodic_task<qrt::virtual_clock> model;
+
+    qrt::response_time_analysis<qrt::virtual_clock> rta;
+    rta.push_back(model(4, 1));
+    rta.push_back(model(5, 1));
+
+    if (rta.response_time(0) != 2 || rta.response_time(1) != 3 || !rta.schedulable()) {
+        std::cerr << "rta: FAILED response times " << rta.response_time(0) << ' ' << rta.response_time(1) << std::endl;
+        errors++;
+    }
+
+    if (!rta.admissible(model(20, 2), 2) || rta.admissible(model(4, 2), 0) || rta.admissible(model(5, 3, 3), 2)) {
+        std::cerr << "rta: FAILED admission" << std::endl;
+        errors++;
+    }
+
+    std::cerr << "rta: " << (errors ? "FAILED" : "ok") << std::endl;
+    return errors != 0;
+}
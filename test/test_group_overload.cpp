@@ -0,0 +1,106 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_thread.hpp>
+#include <qrt_group.hpp>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+// an overloaded scheduler_group with no idle peer (a single scheduler), in
+// virtual time: the overdue threads are shed and nobody steals them. EDF must
+// still serve them in deadline order, so that all the threads progress 
+// together and none of them starves.
+//
+
+typedef qrt::virtual_clock::cycles_type cycles_type;
+typedef qrt::scheduler_group<qrt::virtual_clock> group_type;
+
+static const cycles_type period = 1000;
+static const int activations = 200;
+
+struct mythread : public qrt::virtual_thread
+{
+    cycles_type _M_ts;
+    cycles_type _M_work;
+    cycles_type _M_finish;
+    int _M_n;
+
+public:
+    mythread(cycles_type b, cycles_type work)
+    : qrt::virtual_thread(b, ~cycles_type()), _M_ts(), _M_work(work), _M_finish(), _M_n()
+    {}
+
+    cycles_type 
+    run(cycles_type)
+    {
+        qrt_context_begin;
+
+        for(_M_ts = this->begin(); _M_n < activations; ++_M_n)
+        {
+            qrt::virtual_clock::advance(_M_work);
+            _M_ts += period;
+            qrt_force_schedule(_M_ts);
+        }
+
+        _M_finish = qrt::virtual_clock::now();
+        qrt_context_end;
+    }    
+};
+
+
+int
+main(int, char *[])
+{
+    qrt::virtual_clock::reset();
+
+    // 20 threads x 100 cycles every 1000 cycles: a load of 2...
+
+    std::vector<mythread *> threads;
+    group_type group(std::vector<int>(1, 0));
+
+    for(int i = 0; i < 20; ++i)
+    {
+        threads.push_back(new mythread(period + i, 100));
+        group(threads.back());
+    }
+
+    group.start();
+    group.join();
+
+    cycles_type first = ~cycles_type(), last = 0;
+    for(mythread * t : threads)
+    {
+        first = std::min(first, t->_M_finish);
+        last  = std::max(last, t->_M_finish);
+        delete t;
+    }
+
+    // all done at about the same time (the whole run is 400000 cycles)...
+
+    bool ok = last - first <= 10 * period;
+
+    std::cerr << "finished between " << first << " and " << last << ": " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
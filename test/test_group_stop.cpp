@@ -0,0 +1,128 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <qrt_thread.hpp>
+#include <qrt_group.hpp>
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+
+// an idle member of a scheduler_group (no threads of its own, while a peer
+// still runs some) honors an abort and a drain, and a persistent one parks.
+//
+
+struct service : public qrt::thread
+{
+    qrt::stop_token _M_token;
+    long _M_n;
+
+public:
+    service(qrt::stop_token tok)
+    : qrt::thread(qrt::this_cpu::get_cycles(), qrt::this_cpu::get_cycles() + qrt::tsc_clock::instance().cycles_per_sec() * 5), 
+      _M_token(tok), _M_n(0)
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        while (!_M_token.stop_requested() && qrt::this_cpu::get_cycles() < this->end()) 
+        {
+            _M_n++;
+            qrt_force_schedule(qrt::this_cpu::get_cycles() + qrt::tsc_clock::instance().from_us(100));
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+static long
+elapsed_ms(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static bool
+check(bool cond, const char *what)
+{
+    std::cerr << what << ": " << (cond ? "ok" : "FAILED") << std::endl;
+    return cond;
+}
+
+
+int
+main(int, char *[])
+{
+    bool ok = true;
+
+    // both the schedulers on the first cpu...
+
+    std::vector<int> cpus = { 0, 0 };
+
+    {
+        qrt::deadline_scheduler_group group(cpus);
+
+        service svc(group[0].get_stop_token());
+        group[0](&svc);
+
+        group.start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        group[1].request_stop(qrt::stop_mode::abort);
+        group[1].join();
+
+        ok &= check(elapsed_ms(t0) < 1000, "abort of an idle member");
+
+        group[0].request_stop(qrt::stop_mode::drain);
+        group.join();
+    }
+
+    {
+        qrt::deadline_scheduler_group group(cpus);
+
+        service svc(group[0].get_stop_token());
+        group[0](&svc);
+
+        group[0].persistent(true);
+        group[1].persistent(true);
+        group.start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        group[1].request_stop(qrt::stop_mode::drain);
+        while (!group[1].stopped() && elapsed_ms(t0) < 1000)
+            std::this_thread::yield();
+
+        ok &= check(group[1].stopped(), "drain of an idle persistent member");
+
+        group[0].request_stop(qrt::stop_mode::drain);
+        group.join();
+
+        ok &= check(svc._M_n > 0, "the peer runs meanwhile");
+    }
+
+    return ok ? 0 : 1;
+}
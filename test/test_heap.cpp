@@ -0,0 +1,331 @@
+/* $Id$ */
+/* 
+ * qrt::thread++ - LGPL library 
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <qrt_heap.hpp>
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <set>
+#include <stdexcept>
+
+// this test checks the heap policies against a std::multiset, by
+// simulating the scheduler: pop the earliest deadline and push it back
+// a random period later.
+//
+
+typedef unsigned long long key_type;
+
+template <template <typename, typename> class Heap>
+bool check(const char *name, int nthread, int nrounds, key_type max_period)
+{
+    Heap<key_type, int> heap;
+    std::multiset<key_type> ref;
+    std::mt19937_64 rand(nthread);
+
+    key_type now = 1ULL << 40;
+
+    for(int i = 0; i < nthread; ++i)
+    {
+        key_type k = now + rand() % max_period;
+        heap.push(k, i);
+        ref.insert(k);
+    }
+
+    for(int i = 0; i < nrounds; ++i)
+    {
+        if (ref.empty()) {
+            heap.push(now, i);
+            ref.insert(now);
+        }
+
+        if (heap.empty() || heap.top().first != *ref.begin()) {
+            std::cerr << name << ": FAILED at round " << i << std::endl;
+            return false;
+        }
+
+        std::pair<key_type, int> e = heap.pop();
+        ref.erase(ref.begin());
+        now = e.first;
+
+        // some threads terminate, others come back...
+
+        if (rand() % 8) {
+            key_type k = (rand() % 16) ? now + rand() % max_period : now - rand() % 1000; 
+            heap.push(k, e.second);
+            ref.insert(k);
+        }
+        else if (rand() % 2) {
+            key_type k = now + rand() % (max_period * 1000);
+            heap.push(k, e.second);
+            ref.insert(k);
+        }
+    }
+
+    while (!ref.empty())
+    {
+        if (heap.empty() || heap.pop().first != *ref.begin()) {
+            std::cerr << name << ": FAILED while draining" << std::endl;
+            return false;
+        }
+        ref.erase(ref.begin());
+    }
+
+    if (!heap.empty()) {
+        std::cerr << name << ": FAILED not empty" << std::endl;
+        return false;
+    }
+
+    std::cerr << name << ": ok" << std::endl;
+    return true;
+}
+
+
+template <template <typename, typename> class Heap>
+bool check_all(const char *name)
+{
+    return check<Heap>(name, 1, 1000, 1000) &&
+           check<Heap>(name, 100, 100000, 1000000) &&
+           check<Heap>(name, 10000, 100000, 1ULL << 32) &&
+           check<Heap>(name, 1000, 100000, 1ULL << 50);
+}
+
+
+// static heaps: full capacity...
+//
+
+bool check_overflow()
+{
+    qrt::random_access::static_heap<key_type, int, 4, qrt::random_access::overflow_reject> h0;
+    qrt::random_access::static_heap<key_type, int, 4, qrt::random_access::overflow_throw>  h1;
+
+    static_assert(decltype(h0)::capacity() == 4, "static_heap: capacity");
+
+    for(int i = 0; i < 4; ++i)
+    {
+        h0.push(i,i);
+        h1.push(i,i);
+    }
+
+    bool thrown = false;
+    try { h1.push(4,4); } catch(std::length_error &) { thrown = true; }
+
+    if (h0.push(4,4) || !thrown || h0.pop().first != 0 || !h0.push(4,4)) {
+        std::cerr << "static_heap: FAILED overflow" << std::endl;
+        return false;
+    }
+
+    std::cerr << "static_heap: ok" << std::endl;
+    return true;
+}
+
+
+// intrusive heaps: the elements carry the links, and can be moved earlier...
+//
+
+struct node
+{
+    int id;
+    bool queued;
+    qrt::intrusive::pairing_hook<key_type, node *> hook;
+    std::size_t index;
+
+    qrt::intrusive::pairing_hook<key_type, node *> &
+    pairing()
+    { return hook; }
+
+    std::size_t &
+    heap_index()
+    { return index; }
+};
+
+
+template <template <typename, typename> class Heap>
+bool check_intrusive(const char *name, int nnode, int nrounds)
+{
+    Heap<key_type, node *> heap;
+    std::multiset<std::pair<key_type, int> > ref;
+    std::vector<node> nodes(nnode);
+    std::vector<key_type> keys(nnode);
+    std::mt19937_64 rand(nnode);
+
+    key_type now = 1ULL << 40;
+
+    for(int i = 0; i < nnode; ++i)
+    {
+        nodes[i].id = i;
+        nodes[i].queued = true;
+        keys[i] = now + rand() % 1000000;
+        heap.push(keys[i], &nodes[i]);
+        ref.insert(std::make_pair(keys[i], i));
+    }
+
+    for(int i = 0; i < nrounds; ++i)
+    {
+        // move a random node earlier...
+
+        node &n = nodes[rand() % nnode];
+        if (n.queued && keys[n.id] > now) {
+            ref.erase(std::make_pair(keys[n.id], n.id));
+            keys[n.id] = now + rand() % (keys[n.id] - now);
+            ref.insert(std::make_pair(keys[n.id], n.id));
+            heap.decrease_key(&n, keys[n.id]);
+        }
+
+        if (ref.empty())
+            continue;
+
+        if (heap.empty() || heap.top().first != ref.begin()->first) {
+            std::cerr << name << ": FAILED at round " << i << std::endl;
+            return false;
+        }
+
+        std::pair<key_type, node *> e = heap.pop();
+        ref.erase(std::make_pair(e.first, e.second->id));
+        e.second->queued = false;
+        now = e.first;
+
+        if (rand() % 8) {
+            keys[e.second->id] = now + rand() % 1000000;
+            heap.push(keys[e.second->id], e.second);
+            ref.insert(std::make_pair(keys[e.second->id], e.second->id));
+            e.second->queued = true;
+        }
+    }
+
+    std::cerr << name << ": ok" << std::endl;
+    return true;
+}
+
+
+// heaps that track their elements: random erase and update...
+//
+
+template <template <typename, typename> class Heap>
+bool check_indexed(const char *name, int nnode, int nrounds)
+{
+    Heap<key_type, node *> heap;
+    std::multiset<std::pair<key_type, int> > ref;
+    std::vector<node> nodes(nnode);
+    std::vector<key_type> keys(nnode);
+    std::mt19937_64 rand(nnode);
+
+    key_type now = 1ULL << 40;
+
+    for(int i = 0; i < nnode; ++i)
+    {
+        nodes[i].id = i;
+        nodes[i].queued = true;
+        nodes[i].index = static_cast<std::size_t>(-1);
+        keys[i] = now + rand() % 1000;      // plenty of equal keys
+        ref.insert(std::make_pair(keys[i], i));
+    }
+
+    // the first half one by one, the rest in bulk (push_bulk, if any)...
+
+    std::vector<std::pair<key_type, node *> > bulk;
+    for(int i = 0; i < nnode; ++i)
+    {
+        if (i < nnode / 2)
+            heap.push(keys[i], &nodes[i]);
+        else
+            bulk.push_back(std::make_pair(keys[i], &nodes[i]));
+    }
+    qrt::detail::heap_push_bulk(heap, bulk.begin(), bulk.end());
+
+    for(int i = 0; i < nrounds; ++i)
+    {
+        node &n = nodes[rand() % nnode];
+
+        switch(rand() % 3)
+        {
+        case 0:     // cancel...
+            if (heap.erase(keys[n.id], &n) != n.queued) {
+                std::cerr << name << ": FAILED erase at round " << i << std::endl;
+                return false;
+            }
+            if (n.queued) 
+                ref.erase(std::make_pair(keys[n.id], n.id));
+            else {
+                keys[n.id] = now + rand() % 1000;
+                heap.push(keys[n.id], &n);
+                ref.insert(std::make_pair(keys[n.id], n.id));
+            }
+            n.queued = !n.queued;
+            break;
+        case 1:     // reschedule, earlier or later...
+            {
+                key_type k = now + rand() % 1000;
+                if (heap.update(keys[n.id], &n, k) != n.queued) {
+                    std::cerr << name << ": FAILED update at round " << i << std::endl;
+                    return false;
+                }
+                if (n.queued) {
+                    ref.erase(std::make_pair(keys[n.id], n.id));
+                    ref.insert(std::make_pair(keys[n.id] = k, n.id));
+                }
+            }
+            break;
+        default:    // dispatch...
+            if (ref.empty())
+                break;
+            if (heap.empty() || heap.top().first != ref.begin()->first) {
+                std::cerr << name << ": FAILED at round " << i << std::endl;
+                return false;
+            }
+            std::pair<key_type, node *> e = heap.pop();
+            ref.erase(std::make_pair(e.first, e.second->id));
+            e.second->queued = false;
+            now = e.first;
+        }
+    }
+
+    std::cerr << name << ": ok" << std::endl;
+    return true;
+}
+
+
+int
+main(int, char *[])
+{
+    bool ok = true;
+
+    ok &= check_all<qrt::random_access::vector_heap>("vector_heap");
+    ok &= check_all<qrt::random_access::deque_heap>("deque_heap");
+    ok &= check_all<qrt::random_access::priority_queue_heap>("priority_queue_heap");
+    ok &= check_all<qrt::wheel::timing_wheel>("timing_wheel");
+    ok &= check_all<qrt::wheel::config<0,6,2>::timing_wheel>("timing_wheel<0,6,2>");
+    ok &= check_all<qrt::random_access::static_capacity<16384>::heap>("static_heap");
+    ok &= check_all<qrt::dary::heap>("dary::heap");
+    ok &= check_all<qrt::dary::compact_heap>("dary::compact_heap");
+    ok &= check_all<qrt::dary::config<4,false>::heap>("dary::heap<4>");
+    ok &= check_all<qrt::dary::config<8,true>::heap>("dary::compact_heap<8>");
+    ok &= check_all<qrt::redblack::heap>("redblack::heap");
+
+    ok &= check_overflow();
+    ok &= check_intrusive<qrt::intrusive::pairing_heap>("intrusive::pairing_heap", 1000, 100000);
+    ok &= check_indexed<qrt::indexed::heap>("indexed::heap", 1000, 300000);
+    ok &= check_indexed<qrt::redblack::heap>("redblack::heap (erase/update)", 1000, 300000);
+
+    return ok ? 0 : 1;
+}
+
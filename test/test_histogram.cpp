@@ -0,0 +1,103 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_histogram.hpp>
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <random>
+#include <cstdlib>
+
+// quantiles of qrt::histogram against the exact ones (sorted samples)...
+// 
+
+static int
+check(const char *name, std::vector<uint64_t> &v)
+{
+    qrt::histogram h, a, b;
+
+    for(std::size_t i = 0; i < v.size(); ++i)
+    {
+        h.record(v[i]);
+        (i & 1 ? a : b).record(v[i]);
+    }
+    a.merge(b);
+
+    std::sort(v.begin(), v.end());
+
+    int ret = 0;
+    const double qs[] = { 0.5, 0.9, 0.99, 0.999, 0.9999, 1.0 };
+
+    for(double q : qs)
+    {
+        uint64_t rank  = std::max<uint64_t>(1, static_cast<uint64_t>(q * v.size() + 0.5));
+        uint64_t exact = v[std::min<uint64_t>(rank, v.size()) - 1];
+        uint64_t value = h.quantile(q);
+
+        // never below the exact one, at most 1/32 above...
+        if (value < exact || value - exact > exact / 32) {
+            std::cerr << name << ": q" << q << " = " << value << ", expected " << exact << std::endl;
+            ret = 1;
+        }
+        if (a.quantile(q) != value) {
+            std::cerr << name << ": merged q" << q << " = " << a.quantile(q) << ", expected " << value << std::endl;
+            ret = 1;
+        }
+    }
+
+    if (h.min() != v.front() || h.max() != v.back() || h.count() != v.size()) {
+        std::cerr << name << ": min/max/count mismatch" << std::endl;
+        ret = 1;
+    }
+
+    std::cout << name << ": " << h << std::endl;
+    return ret;
+}
+
+int
+main(int, char *[])
+{
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> v;
+    int ret = 0;
+
+    for(int i = 0; i < 100000; ++i)
+        v.push_back(rng() % 100);
+    ret |= check("uniform(100)", v);
+
+    v.clear();
+    std::exponential_distribution<double> exp(1.0/5000);
+    for(int i = 0; i < 1000000; ++i)
+        v.push_back(static_cast<uint64_t>(exp(rng)));
+    ret |= check("exponential(5000)", v);
+
+    v.clear();
+    std::lognormal_distribution<double> logn(12.0, 2.0);
+    for(int i = 0; i < 1000000; ++i)
+        v.push_back(static_cast<uint64_t>(logn(rng)));
+    v.push_back(1ULL << 50);    // clamped to the last bucket
+    ret |= check("lognormal(12,2)", v);
+
+    return ret;
+}
@@ -0,0 +1,83 @@
+/* $Id$ */
+/* 
+ * qrt::thread++ - LGPL library 
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_utils.hpp>
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <time.h>
+
+// wake-up lateness and cpu time of the idle strategies of busywait_until...
+// 
+
+static uint64_t
+cputime_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+template <typename Cpu>
+void measure(const char *name, int n, uint64_t period_us)
+{
+    const qrt::tsc_clock &clock = qrt::tsc_clock::instance();
+
+    uint64_t lmin = ~0ULL, lmax = 0, lsum = 0;
+    uint64_t c0 = cputime_ns();
+    uint64_t w0 = clock.to_ns(qrt::tsc_clock::get_cycles());
+
+    for(int i = 0; i < n; ++i)
+    {
+        typename Cpu::cycles_type t = Cpu::get_cycles() + clock.from_us(period_us);
+        Cpu::busywait_until(t);
+        uint64_t late = clock.to_ns(Cpu::get_cycles() - t);
+        lmin = std::min(lmin, late);
+        lmax = std::max(lmax, late);
+        lsum += late;
+    }
+
+    uint64_t cpu  = cputime_ns() - c0;
+    uint64_t wall = clock.to_ns(qrt::tsc_clock::get_cycles()) - w0;
+
+    std::cout << name << ": lateness min " << lmin << " ns, avg " << lsum/n << " ns, max " << lmax 
+              << " ns, cpu " << cpu * 100 / wall << "%" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int n           = argc > 1 ? atoi(argv[1]) : 1000;
+    uint64_t period = argc > 2 ? atoi(argv[2]) : 500;   // us
+
+    qrt::tsc_clock::instance();
+
+    std::cout << "waitpkg: " << (qrt::idle::waitpkg::available() ? "available" : "not available") << std::endl;
+
+    measure<qrt::this_cpu>   ("spin   ", n, period);
+    measure<qrt::pause_cpu>  ("pause  ", n, period);
+    measure<qrt::waitpkg_cpu>("waitpkg", n, period);
+    measure<qrt::hybrid_cpu> ("hybrid ", n, period);
+    return 0;
+}
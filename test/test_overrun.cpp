@@ -0,0 +1,115 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <qrt_thread.hpp>
+
+#include <iostream>
+
+// a periodic thread hit by a single hiccup, in virtual time: the overrun
+// policy decides how many late activations follow it. 
+//
+
+typedef qrt::basic_scheduler<qrt::virtual_clock, qrt::null_native_thread, 
+                             qrt::random_access::vector_heap, qrt::stat_per_thread> scheduler;
+
+static const qrt::virtual_clock::cycles_type period = 1000;
+
+struct mythread : public qrt::virtual_thread
+{
+    int _M_n;
+    int _M_degraded;
+
+public:
+    mythread(qrt::virtual_clock::cycles_type b, qrt::virtual_clock::cycles_type e)
+    : qrt::virtual_thread(b,e), _M_n(), _M_degraded()
+    {}
+
+    qrt::virtual_clock::cycles_type 
+    run(qrt::virtual_clock::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(; this->next_deadline() < this->end(); ++_M_n)
+        {
+            qrt::virtual_clock::advance(_M_n == 10 ? 3500 : 100);   // the hiccup
+            qrt_next_period(period);
+        }
+
+        qrt_context_end;
+    }    
+
+    qrt::virtual_clock::cycles_type 
+    degrade(qrt::virtual_clock::cycles_type, qrt::virtual_clock::cycles_type now)
+    {
+        _M_degraded++;
+        return now + period;
+    }
+};
+
+
+qrt::thread_stat<qrt::virtual_clock>
+replay(const qrt::overrun &policy, int &degraded)
+{
+    qrt::virtual_clock::reset();
+
+    scheduler sched0;
+    mythread a(period, 100 * period);
+
+    a.overrun_policy(policy);
+
+    sched0(&a);
+    sched0.start();
+    sched0.join();
+
+    degraded = a._M_degraded;
+    return a.stat();
+}
+
+
+int
+main(int, char *[])
+{
+    const char * name[] = { "none", "skip", "catch_up", "degrade" };
+
+    struct { qrt::overrun policy; unsigned long misses, skipped; int degraded; } expect[] = 
+    {
+        { qrt::overrun(qrt::overrun::none),        3, 0, 0 },
+        { qrt::overrun(qrt::overrun::skip),        0, 3, 0 },
+        { qrt::overrun(qrt::overrun::catch_up, 1), 1, 2, 0 },
+        { qrt::overrun(qrt::overrun::degrade),     0, 0, 1 },
+    };
+
+    int ret = 0;
+
+    for(auto &e : expect)
+    {
+        int degraded;
+        qrt::thread_stat<qrt::virtual_clock> s = replay(e.policy, degraded);
+
+        std::cerr << name[e.policy.policy] << ": " << s.activations << " activations, " << s.misses << " late, " 
+                  << s.skipped << " skipped, " << degraded << " degraded" << std::endl;
+
+        if (s.misses != e.misses || s.skipped != e.skipped || degraded != e.degraded)
+            ret = 1;
+    }
+
+    return ret;
+}
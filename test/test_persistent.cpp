@@ -0,0 +1,182 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <qrt_thread.hpp>
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// a persistent scheduler survives empty periods (parked on a futex), is 
+// stopped by drain or abort and restarted on the same OS thread.
+//
+
+static std::atomic<int> completed;
+
+struct burst : public qrt::thread
+{
+    int _M_n;
+
+public:
+    burst()
+    : qrt::thread(qrt::this_cpu::get_cycles(), ~qrt::this_cpu::cycles_type()), _M_n()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(; _M_n < 10; ++_M_n)
+            qrt_force_schedule(qrt::this_cpu::get_cycles() + qrt::tsc_clock::instance().from_us(10));
+
+        completed++;
+        qrt_context_end;
+    }    
+};
+
+
+// runs until the scheduler is asked to stop (if it has a token), at most limit times...
+
+struct service : public qrt::thread
+{
+    qrt::stop_token _M_token;
+    long _M_limit;
+    std::atomic<long> _M_n;
+
+public:
+    service(qrt::stop_token tok, long limit)
+    : qrt::thread(qrt::this_cpu::get_cycles(), ~qrt::this_cpu::cycles_type()), _M_token(tok), _M_limit(limit), _M_n(0)
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        while (!_M_token.stop_requested() && _M_n < _M_limit) 
+        {
+            _M_n++;
+            qrt_force_schedule(qrt::this_cpu::get_cycles() + qrt::tsc_clock::instance().from_us(100));
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+static void
+pause_ms(int ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static bool
+check(bool cond, const char *what)
+{
+    std::cerr << what << ": " << (cond ? "ok" : "FAILED") << std::endl;
+    return cond;
+}
+
+
+int
+main(int, char *[])
+{
+    bool ok = true;
+
+    qrt::deadline_scheduler sched0;
+    std::vector<std::unique_ptr<burst> > bursts;
+
+    sched0.persistent(true);
+    sched0.start();
+
+    std::thread::native_handle_type handle = sched0.native_handle();
+
+    // bursts of work, separated by empty periods...
+
+    for(int b = 0; b < 5; ++b)
+    {
+        for(int i = 0; i < 10; ++i) {
+            bursts.emplace_back(new burst);
+            sched0.submit(bursts.back().get());
+        }
+        pause_ms(50);
+    }
+
+    ok &= check(completed == 50 && !sched0.stopped(), "bursts, parked in between");
+
+    // drain, then a submission while stopped stays queued until the restart...
+
+    for(int i = 0; i < 10; ++i) {
+        bursts.emplace_back(new burst);
+        sched0.submit(bursts.back().get());
+    }
+
+    sched0.request_stop(qrt::stop_mode::drain);
+    sched0.wait_stopped();
+
+    ok &= check(completed == 60, "drain");
+
+    bursts.emplace_back(new burst);
+    sched0.submit(bursts.back().get());
+    pause_ms(20);
+
+    ok &= check(completed == 60, "stopped");
+
+    sched0.start();
+    pause_ms(50);
+
+    ok &= check(completed == 61 && sched0.native_handle() == handle, "restart on the same thread");
+
+    // abort: the service stays queued, and resumes after the restart...
+
+    service svc(qrt::stop_token(), 1000);
+    sched0.submit(&svc);
+    pause_ms(20);
+
+    sched0.request_stop(qrt::stop_mode::abort);
+    sched0.wait_stopped();
+
+    long n0 = svc._M_n;
+    pause_ms(20);
+
+    ok &= check(n0 > 0 && svc._M_n == n0, "abort");
+
+    sched0.start();
+    pause_ms(20);
+
+    ok &= check(svc._M_n > n0, "restart after abort");
+
+    // join: drain (the second service sees the stop token) and leave...
+
+    service tok(sched0.get_stop_token(), 1L << 40);
+    sched0.submit(&tok);
+    pause_ms(20);
+
+    sched0.join();
+
+    ok &= check(svc._M_n == 1000 && tok._M_n > 0, "join");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+/* $Id$ */
+/* 
+ * qrt::thread++ - LGPL library 
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <qrt_cpufreq.hpp>
+#include <qrt_thread.hpp>
+
+#include <sys/mman.h>
+#include <iostream>
+
+// all the threads are registered on the first scheduler of the group: 
+// the idle schedulers are expected to steal the overdue ones.
+// 
+
+struct mythread : public qrt::thread
+{
+    int _M_rate;
+
+    qrt::this_cpu::cycles_type inter_time;
+    qrt::this_cpu::cycles_type ts;
+
+public:
+    mythread(qrt::this_cpu::cycles_type b, qrt::this_cpu::cycles_type e, int r)
+    : qrt::thread(b,e),
+      _M_rate(r)
+    {}
+
+    // thread body...
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        inter_time = qrt::tsc_clock::instance().cycles_per_sec()/_M_rate;
+
+        for( ts = qrt::this_cpu::get_cycles(); qrt::this_cpu::get_cycles() < this->end() ; )
+        {
+            ts += inter_time;
+
+            // some work...
+            qrt::this_cpu::busywait_for(inter_time/4);
+
+            qrt_context_switch(ts);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        std::cerr << "usage: schedulers threads rate" << std::endl;
+        exit(1);
+    }
+    
+    int nsched  = atoi(argv[1]);
+    int nthread = atoi(argv[2]);
+    int rate    = atoi(argv[3]);
+
+    qrt::cpufreq(0).set_policy_governor("performance");
+    qrt::this_cpu::cycles_type sec = qrt::tsc_clock::instance().cycles_per_sec();
+
+    qrt::stat_deadline_scheduler_group group(nsched);
+
+    group.schedparam(SCHED_FIFO,99);
+    group.slack(sec/rate/4);
+
+    for(int i = 0; i < nthread; ++i ) 
+    {
+        mythread * t = new mythread(qrt::this_cpu::get_cycles(), qrt::this_cpu::get_cycles() + sec * 5, rate);
+        group[0](t);        
+    }
+
+    mlockall(MCL_CURRENT|MCL_FUTURE);
+
+    group.start();
+    group.join();
+
+    for(std::size_t i = 0; i < group.size(); ++i)
+        std::cerr << "sched #" << i << ' ' << group[i].stat() << std::endl;
+    std::cerr << "group " << group.stat() << std::endl;
+
+    std::cerr << group.steals() << " migrations" << std::endl;
+    return 0;
+}
+
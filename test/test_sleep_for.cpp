@@ -43,7 +43,7 @@ public:
     {
         qrt_context_begin;
 
-        inter_time = qrt::cpufreq(0).freq_hardware() * 1000/_M_rate;
+        inter_time = qrt::tsc_clock::instance().cycles_per_sec()/_M_rate;
 
         for( ts = qrt::this_cpu::get_cycles(); qrt::this_cpu::get_cycles() < this->end() ; )
         {
@@ -60,7 +60,7 @@ public:
 int
 main(int argc, char *argv[])
 {
-    qrt::this_cpu::cycles_type sec  = qrt::cpufreq(0).freq_hardware() * 1000;
+    qrt::this_cpu::cycles_type sec  = qrt::tsc_clock::instance().cycles_per_sec();
 
     // switch to performance governor:
 
@@ -0,0 +1,144 @@
+/* $Id$ */
+/* 
+ * qrt::thread++ - LGPL library 
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_thread.hpp>
+#include <qrt_context.hpp>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <atomic>
+
+// stackful threads with stacks recycled from a stack_pool, shared by two
+// schedulers that give the stacks back concurrently...
+// 
+
+std::atomic<int> done;
+
+struct mythread : public qrt::pooled_stackful_thread
+{
+public:
+    mythread(qrt::this_cpu::cycles_type b, qrt::this_cpu::cycles_type e)
+    : qrt::pooled_stackful_thread(b,e)
+    {}
+
+    // suspend from a nested call...
+
+    void
+    nested(int depth)
+    {
+        volatile char frame[512];
+        frame[0] = static_cast<char>(depth);
+
+        if (depth)
+            nested(depth-1);
+        else
+            this->context_switch(qrt::this_cpu::get_cycles() + 1000);
+
+        (void)frame[0];
+    }
+
+    void 
+    main()
+    {
+        for(int n = 0; n < 10; ++n)
+            nested(8);
+
+        done++;
+    }    
+};
+
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "usage: threads [hugepages|packed]" << std::endl;
+        exit(1);
+    }
+    
+    int nthread    = atoi(argv[1]);
+    bool packed    = argc > 2 && std::string(argv[2]) == "packed";      /* hugepages, no guards */
+    bool hugepages = argc > 2 && (std::string(argv[2]) == "hugepages" || packed);
+
+    qrt::this_cpu::cycles_type sec = qrt::tsc_clock::instance().cycles_per_sec();
+
+    qrt::stack_pool pool(nthread, qrt::stackful_thread::default_stack_size, hugepages, !packed);
+
+    qrt::stack_pool::scope scope(pool);
+
+    // twice: the second round reuses the stacks of the first one...
+
+    for(int round = 0; round < 2; ++round)
+    {
+        qrt::deadline_scheduler sched0, sched1;
+        std::vector<mythread *> threads;
+
+        for(int i = 0; i < nthread; ++i)
+        {
+            threads.push_back(new mythread(qrt::this_cpu::get_cycles(), qrt::this_cpu::get_cycles() + sec));
+            (i & 1 ? sched1 : sched0)(threads.back());
+        }
+
+        if (pool.available() != 0) {
+            std::cerr << "pool: " << pool.available() << " stacks still available" << std::endl;
+            return 1;
+        }
+
+        // the stacks are locked by the first start...
+
+        sched0.lock_at_start(pool);
+        try {
+            sched0.start();
+            sched1.start();
+        }
+        catch(std::exception &e) {
+            std::cerr << "warning: " << e.what() << " (stacks cannot be locked, test skipped)" << std::endl;
+            return 0;
+        }
+
+        if (!pool.locked()) {
+            std::cerr << "pool: stacks not locked at start" << std::endl;
+            return 1;
+        }
+
+        sched0.join();
+        sched1.join();
+
+        // ...and given back as soon as the threads complete
+
+        if (pool.available() != pool.capacity()) {
+            std::cerr << "pool: " << pool.capacity() - pool.available() << " stacks held by completed threads" << std::endl;
+            return 1;
+        }
+
+        for(mythread * t : threads)
+            delete t;
+    }
+
+    std::cerr << done << '/' << nthread * 2 << " threads completed, " 
+              << pool.available() << '/' << pool.capacity() << " stacks available" << std::endl;
+
+    return done == nthread * 2 && pool.available() == pool.capacity() ? 0 : 1;
+}
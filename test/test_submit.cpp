@@ -0,0 +1,123 @@
+/* $Id$ */
+/* 
+ * qrt::thread++ - LGPL library 
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <qrt_thread.hpp>
+
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// producers submit short-lived threads to a running scheduler...
+// 
+
+std::atomic<int> done;
+
+struct keeper : public qrt::thread
+{
+    qrt::this_cpu::cycles_type ts;
+
+public:
+    keeper(qrt::this_cpu::cycles_type b, qrt::this_cpu::cycles_type e)
+    : qrt::thread(b,e)
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for( ts = qrt::this_cpu::get_cycles(); qrt::this_cpu::get_cycles() < this->end() ; )
+        {
+            ts += 100000;
+            qrt_context_switch(ts);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+struct mythread : public qrt::thread
+{
+    int n;
+
+public:
+    mythread(qrt::this_cpu::cycles_type b, qrt::this_cpu::cycles_type e)
+    : qrt::thread(b,e), n()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(n = 0; n < 10; ++n)
+        {
+            qrt_context_switch(qrt::this_cpu::get_cycles() + 1000);
+        }
+
+        done++;
+        qrt_context_end;
+    }    
+};
+
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cerr << "usage: producers threads" << std::endl;
+        exit(1);
+    }
+    
+    int nprod   = atoi(argv[1]);
+    int nthread = atoi(argv[2]);
+
+    qrt::this_cpu::cycles_type sec = qrt::tsc_clock::instance().cycles_per_sec();
+
+    qrt::deadline_scheduler sched0;
+
+    keeper k(qrt::this_cpu::get_cycles(), qrt::this_cpu::get_cycles() + sec * 5);
+    sched0(&k);
+
+    sched0.start();
+
+    std::vector<std::thread> producers;
+    for(int p = 0; p < nprod; ++p)
+    {
+        producers.push_back(std::thread([&]() {
+            for(int i = 0; i < nthread; ++i)
+            {
+                sched0.submit(new mythread(qrt::this_cpu::get_cycles(), qrt::this_cpu::get_cycles() + sec));
+            }
+        }));
+    }
+
+    for(auto &p : producers)
+        p.join();
+
+    sched0.join();
+
+    std::cerr << done << '/' << nprod * nthread << " threads completed" << std::endl;
+    return done == nprod * nthread ? 0 : 1;
+}
+
@@ -0,0 +1,119 @@
+/* $Id$ */
+/* 
+ * qrt::thread++ - LGPL library 
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <qrt_cpufreq.hpp>
+#include <qrt_task.hpp>
+
+#include <sys/mman.h>
+#include <iostream>
+#include <vector>
+#include <memory>
+
+// this test measures the cost of context switch of the C++20 coroutines
+// in timestamp counters (see test_context_swich.cpp for the stackless macros):
+// as bench_switch, every coroutine yields with an expired deadline, hence the
+// next one is dispatched at once and no deadline busywait is timed.
+// 
+
+qrt::this_cpu::cycles_type ts_beg;
+qrt::this_cpu::cycles_type sw_min = ~0ULL;
+
+static void
+switched()
+{
+    // the cost of the switch from the previous coroutine...
+
+    qrt::this_cpu::cycles_type d = qrt::this_cpu::get_cycles() - ts_beg;
+    sw_min = std::min(sw_min, d);
+}
+
+qrt::task
+worker(int n)
+{
+    for(int i = 0; i < n; ++i)
+    {
+        ts_beg = qrt::this_cpu::get_cycles();
+        co_await qrt::until(ts_beg);
+        switched();
+    }
+}
+
+qrt::task
+sleeper(int n)
+{
+    for(int i = 0; i < n; ++i)
+    {
+        ts_beg = qrt::this_cpu::get_cycles();
+        co_await qrt::sleep_for(0);
+        switched();
+    }
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cerr << "usage: threads switches" << std::endl;
+        exit(1);
+    }
+    
+    int nthread = atoi(argv[1]);
+    int nswitch = atoi(argv[2]);
+
+    qrt::cpufreq(0).set_policy_governor("performance");
+
+    qrt::stat_deadline_scheduler sched0;
+    qrt::frame_arena arena(1 << 20);
+
+    sched0.schedparam(SCHED_FIFO,99);
+    sched0.affinity(0 /* core */);
+
+    std::vector<std::unique_ptr<qrt::task_thread> > threads;
+    {
+        qrt::frame_arena::scope scope(arena);
+
+        qrt::this_cpu::cycles_type now = qrt::this_cpu::get_cycles();
+        for(int i = 0; i < nthread; ++i ) 
+        {
+            threads.emplace_back(new qrt::task_thread(now, ~0ULL, worker(nswitch)));
+            sched0(threads.back().get());        
+        }
+
+        threads.emplace_back(new qrt::task_thread(now, ~0ULL, sleeper(nswitch)));
+        sched0(threads.back().get());        
+    }
+
+    mlockall(MCL_CURRENT|MCL_FUTURE);
+
+    qrt::tsc_clock::cycles_type t0 = qrt::tsc_clock::rdtsc_ordered();
+    sched0.start();
+    sched0.join();
+    qrt::tsc_clock::cycles_type t1 = qrt::tsc_clock::rdtsc_ordered();
+
+    std::cerr << sched0.stat() << std::endl;
+    std::cerr << "context switch: " << sw_min << " cycles (min), " 
+              << double(t1 - t0) / (double(nthread + 1) * (nswitch + 1)) << " cycles (mean)" << std::endl;
+    std::cerr << "arena: " << arena.used() << " bytes" << std::endl;
+    return 0;
+}
+
@@ -0,0 +1,136 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_thread.hpp>
+
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// a monitor reads the per-thread stat while the scheduler runs...
+// 
+
+struct mythread : public qrt::thread
+{
+    qrt::this_cpu::cycles_type ts;
+    int n;
+
+public:
+    mythread(qrt::this_cpu::cycles_type b, qrt::this_cpu::cycles_type e)
+    : qrt::thread(b,e), ts(), n()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(ts = qrt::this_cpu::get_cycles(); qrt::this_cpu::get_cycles() < this->end() ; )
+        {
+            ts += 20000;
+            
+            // some work...
+            for(n = 0; n < 1000; ++n)
+                __asm__ __volatile__("" ::: "memory");
+
+            qrt_force_schedule(ts);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+int
+main(int argc, char *argv[])
+{
+    int nthread = argc > 1 ? atoi(argv[1]) : 4;
+
+    const qrt::tsc_clock &clock = qrt::tsc_clock::instance();
+
+    qrt::thread_stat_deadline_scheduler sched0;
+    std::vector<mythread *> threads;
+
+    for(int i = 0; i < nthread; ++i)
+    {
+        threads.push_back(new mythread(qrt::this_cpu::get_cycles(), qrt::this_cpu::get_cycles() + clock.from_ms(500)));
+        sched0(threads.back());
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<int>  errors(0);
+
+    std::thread monitor([&]() {
+        std::vector<unsigned long> last(threads.size());
+        while (!stop.load())
+        {
+            for(std::size_t i = 0; i < threads.size(); ++i)
+            {
+                qrt::thread_stat<qrt::this_cpu> s = threads[i]->stat();
+
+                // invariants of a consistent snapshot...
+                if (s.activations < last[i] || s.misses > s.activations || 
+                    s.wcet > s.exec || (s.activations && s.lateness_min > s.lateness_max)) 
+                    errors++;
+                last[i] = s.activations;
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    sched0.start();
+    sched0.join();
+
+    stop.store(true);
+    monitor.join();
+
+    for(std::size_t i = 0; i < threads.size(); ++i)
+    {
+        qrt::thread_stat<qrt::this_cpu> s = threads[i]->stat();
+        std::cout << "thread #" << i << ": " << s.activations << " activations, " << s.misses << " misses, "
+                  << "exec " << clock.to_ns(s.exec) / 1000 << " us, wcet " << clock.to_ns(s.wcet) << " ns, "
+                  << "lateness " << clock.to_ns(s.lateness_min) << ".." << clock.to_ns(s.lateness_max) << " ns" << std::endl;
+        if (s.activations == 0)
+            errors++;
+        delete threads[i];
+    }
+
+    // without stat_per_thread, the threads keep no stat at all...
+
+    {
+        qrt::stat_deadline_scheduler sched1;
+        mythread t(qrt::this_cpu::get_cycles(), qrt::this_cpu::get_cycles() + clock.from_ms(10));
+
+        sched1(&t);
+        sched1.start();
+        sched1.join();
+
+        if (t.stat().activations != 0)
+            errors++;
+    }
+
+    std::cerr << sched0.stat() << std::endl;
+    std::cerr << errors << " inconsistent snapshots" << std::endl;
+    return errors != 0;
+}
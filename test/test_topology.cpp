@@ -0,0 +1,173 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_thread.hpp>
+#include <qrt_topology.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// discovery and placement on a fake sysfs (8 cpus, 4 SMT cores, 2-3 
+// isolated, 3 nohz_full), then a scheduler pinned on the real one.
+//
+
+std::string root;
+
+void
+put(const std::string &path, const std::string &value)
+{
+    std::string dir;
+    for(std::string::size_type i = path.find('/'); i != std::string::npos; i = path.find('/', i+1))
+    {
+        dir = root + "/" + path.substr(0, i);
+        ::mkdir(dir.c_str(), 0755);
+    }
+    std::ofstream out((root + "/" + path).c_str());
+    out << value << '\n';
+}
+
+
+void
+make_sysfs()
+{
+    char tmpl[] = "/tmp/qrt_topology.XXXXXX";
+    if (!::mkdtemp(tmpl))
+        throw std::runtime_error("mkdtemp");
+    root = tmpl;
+
+    put("online", "0-7");
+    put("isolated", "2-3,6-7");
+    put("nohz_full", "3,7");
+
+    for(int n = 0; n < 8; ++n)
+    {
+        std::string cpu = "cpu" + std::to_string(n);
+        std::string sib = std::to_string(n % 4) + "," + std::to_string(n % 4 + 4);
+
+        put(cpu + "/topology/physical_package_id", "0");
+        put(cpu + "/topology/core_id", std::to_string(n % 4));
+        put(cpu + "/topology/thread_siblings_list", sib);
+
+        put(cpu + "/cache/index0/level", "1");
+        put(cpu + "/cache/index0/type", "Data");
+        put(cpu + "/cache/index0/shared_cpu_list", sib);
+        put(cpu + "/cache/index1/level", "1");
+        put(cpu + "/cache/index1/type", "Instruction");
+        put(cpu + "/cache/index1/shared_cpu_list", sib);
+        put(cpu + "/cache/index2/level", "3");
+        put(cpu + "/cache/index2/type", "Unified");
+        put(cpu + "/cache/index2/shared_cpu_list", "0-7");
+    }
+}
+
+
+bool
+check(bool cond, const char *what)
+{
+    std::cout << what << ": " << (cond ? "ok" : "FAILED") << std::endl;
+    return cond;
+}
+
+
+std::string
+str(const qrt::placement &p)
+{
+    std::string s;
+    for(const qrt::cpu_mask &m : p.cpus)
+        s += (s.empty() ? "" : " ") + m.to_string();
+    return s;
+}
+
+
+int
+main(int, char *[])
+{
+    bool ok = true;
+
+    qrt::cpu_mask m = qrt::cpu_mask::parse("0-3,8,10-11\n");
+    ok &= check(m.count() == 7 && m.to_string() == "0-3,8,10-11", "parse");
+
+    make_sysfs();
+    
+    {
+        qrt::cpu_topology topo(root);
+
+        ok &= check(topo.size() == 8 && topo.cores().size() == 4 && topo.packages() == 1, "cores");
+        ok &= check(topo.cpu(1).siblings.to_string() == "1,5", "siblings");
+        ok &= check(topo.cpu(0).llc_level == 3 && topo.cpu(0).llc.count() == 8, "llc");
+        ok &= check(topo.cpu(6).isolated && !topo.cpu(6).nohz_full && topo.cpu(7).nohz_full, "isolated/nohz_full");
+
+        // isolated (nohz_full first), then the others, the core of cpu 0 last...
+
+        qrt::placement p = qrt::place(topo, 3);
+        ok &= check(str(p) == "3 2 1" && p.housekeeping.to_string() == "0,4-5", "place");
+
+        p = qrt::place(topo, 2, qrt::placement::reserve_sibling);
+        ok &= check(str(p) == "3 2" && p.reserved.to_string() == "6-7", "reserve sibling");
+
+        p = qrt::place(topo, 3, 0, qrt::cpu_mask::single(5));
+        ok &= check(str(p) == "3 2 0", "exclude");
+
+        p = qrt::place(topo, 6);
+        ok &= check(str(p) == "3 2 1 0 7 6", "siblings when out of cores");
+
+        bool thrown = false;
+        try 
+        {
+            qrt::place(topo, 3, qrt::placement::isolated_only | qrt::placement::reserve_sibling);
+        }
+        catch(std::runtime_error &)
+        {
+            thrown = true;
+        }
+        ok &= check(thrown, "does not fit");
+    }
+
+    std::system(("rm -rf " + root).c_str());
+
+    // the real thing: a scheduler on the first placed cpu...
+
+    qrt::cpu_topology topo;
+    std::cout << topo.size() << " cpus, " << topo.cores().size() << " cores, " << topo.packages() 
+              << " package(s), isolated [" << topo.isolated().to_string() << "]" << std::endl;
+
+    qrt::placement p = qrt::place(topo, 1);
+
+    qrt::deadline_scheduler sched0;
+    sched0.persistent(true);
+    sched0.affinity(p.cpus[0]);
+    sched0.start();
+
+    cpu_set_t set;
+    ::pthread_getaffinity_np(sched0.native_handle(), sizeof(set), &set);
+    ok &= check(qrt::cpu_mask(set) == p.cpus[0], "affinity mask");
+
+    sched0.join();
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_thread.hpp>
+#include <qrt_trace.hpp>
+
+#include <iostream>
+#include <vector>
+#include <map>
+
+// record the scheduling trace of a few threads in a file-backed ring, and 
+// check it (convert it with tools/qrt_trace2json)...
+// 
+
+struct mythread : public qrt::thread
+{
+    qrt::this_cpu::cycles_type ts;
+
+public:
+    mythread(qrt::this_cpu::cycles_type b, qrt::this_cpu::cycles_type e)
+    : qrt::thread(b,e), ts()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(ts = qrt::this_cpu::get_cycles(); qrt::this_cpu::get_cycles() < this->end() ; )
+        {
+            ts += 50000;
+            qrt_force_schedule(ts);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+int
+main(int argc, char *argv[])
+{
+    const char * path = argc > 1 ? argv[1] : "qrt_trace.bin";
+    int nthread       = argc > 2 ? atoi(argv[2]) : 4;
+
+    const qrt::tsc_clock &clock = qrt::tsc_clock::instance();
+
+    qrt::trace_ring ring(path, 1 << 20, 0 /* sched tag */);
+
+    qrt::deadline_scheduler sched0;
+    sched0.trace(&ring);
+
+    std::vector<mythread *> threads;
+    for(int i = 0; i < nthread; ++i)
+    {
+        threads.push_back(new mythread(qrt::this_cpu::get_cycles(), qrt::this_cpu::get_cycles() + clock.from_ms(100)));
+        sched0(threads.back());
+    }
+
+    sched0.start();
+    sched0.join();
+
+    // check the trace...
+
+    std::map<uint32_t, int> count;
+    int errors = 0;
+    uint64_t last = 0;
+
+    for(std::size_t i = 0; i < ring.size(); ++i)
+    {
+        const qrt::trace_event &e = ring[i];
+        count[e.type]++;
+        if (e.tsc < last)
+            errors++;
+        last = e.tsc;
+    }
+
+    std::cerr << ring.size() << " events: " 
+              << count[qrt::trace_event::add] << " add, "
+              << count[qrt::trace_event::dispatch] << " dispatch, "
+              << count[qrt::trace_event::miss] << " miss, "
+              << count[qrt::trace_event::ret] << " ret, "
+              << count[qrt::trace_event::finish] << " finish -> " << path << std::endl;
+
+    if (ring.size() < ring.capacity())
+    {
+        if (count[qrt::trace_event::add] != nthread || count[qrt::trace_event::finish] != nthread ||
+            count[qrt::trace_event::dispatch] != count[qrt::trace_event::ret] + count[qrt::trace_event::finish])
+            errors++;
+    }
+
+    for(mythread * t : threads)
+        delete t;
+
+    return errors != 0;
+}
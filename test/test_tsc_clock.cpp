@@ -0,0 +1,85 @@
+/* $Id$ */
+/* 
+ * qrt::thread++ - LGPL library 
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_utils.hpp>
+
+#include <iostream>
+#include <cstdlib>
+#include <time.h>
+
+// calibrate the tsc_clock and check it against CLOCK_MONOTONIC_RAW...
+// 
+
+static uint64_t
+monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+int
+main(int, char *[])
+{
+    const qrt::tsc_clock &clock = qrt::tsc_clock::instance();
+
+    std::cout << "invariant tsc: " << (qrt::tsc_clock::invariant() ? "yes" : "no") << std::endl;
+    std::cout << "tsc rate: " << clock.cycles_per_sec() << " Hz" << std::endl;
+
+    int ret = 0;
+
+    // round-trip conversions...
+
+    for(uint64_t ns = 1000; ns <= 1000000000000ULL; ns *= 10)
+    {
+        uint64_t back = clock.to_ns(clock.from_ns(ns));
+        uint64_t err  = back > ns ? back - ns : ns - back;
+        if (err * 1000000 > ns + 1000000) {
+            std::cerr << "round-trip " << ns << " ns -> " << back << " ns" << std::endl;
+            ret = 1;
+        }
+    }
+
+    // 100 ms busy-wait measured by both clocks...
+
+    uint64_t n0 = monotonic_ns();
+    qrt::tsc_clock::cycles_type c0 = qrt::tsc_clock::rdtsc_ordered();
+
+    qrt::this_cpu::busywait_for(clock.from_ms(100));
+
+    qrt::tsc_clock::cycles_type c1 = qrt::tsc_clock::rdtscp();
+    uint64_t n1 = monotonic_ns();
+
+    uint64_t tsc_ns  = clock.to_ns(c1 - c0);
+    uint64_t mono_ns = n1 - n0;
+    uint64_t diff    = tsc_ns > mono_ns ? tsc_ns - mono_ns : mono_ns - tsc_ns;
+
+    std::cout << "100ms: tsc " << tsc_ns << " ns, monotonic_raw " << mono_ns << " ns" << std::endl;
+
+    if (diff * 1000 > mono_ns) {  // 0.1%
+        std::cerr << "tsc_clock drift too large" << std::endl;
+        ret = 1;
+    }
+
+    return ret;
+}
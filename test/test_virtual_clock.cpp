@@ -0,0 +1,119 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_thread.hpp>
+
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+
+// replay a long scheduling run in virtual time, twice: the two runs must
+// dispatch the threads in the same order at the same (virtual) times.
+// 
+
+static const qrt::virtual_clock::cycles_type hz = 1000000000;    // a 1GHz virtual cpu
+
+unsigned long long digest;
+
+struct mythread : public qrt::virtual_thread
+{
+    int                             _M_index;
+    qrt::virtual_clock::cycles_type _M_period;
+    qrt::virtual_clock::cycles_type _M_ts;
+
+public:
+    mythread(int n, qrt::virtual_clock::cycles_type b, qrt::virtual_clock::cycles_type e, qrt::virtual_clock::cycles_type p)
+    : qrt::virtual_thread(b,e), _M_index(n), _M_period(p), _M_ts()
+    {}
+
+    qrt::virtual_clock::cycles_type 
+    run(qrt::virtual_clock::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(_M_ts = this->begin(); _M_ts < this->end(); )
+        {
+            digest = digest * 1000003 + _M_index * 31 + qrt::virtual_clock::get_cycles();
+
+            qrt::virtual_clock::advance(1000);      // 1us of work
+            
+            _M_ts += _M_period;
+            qrt_force_schedule(_M_ts);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+unsigned long long
+replay(int nthread, int seconds, int &dispatch)
+{
+    std::mt19937_64 rand(nthread);
+    std::vector<mythread *> threads;
+
+    qrt::virtual_clock::reset();
+    digest = 0;
+
+    qrt::stat_virtual_scheduler sched0;
+
+    for(int i = 0; i < nthread; ++i)
+    {
+        qrt::virtual_clock::cycles_type period = hz / 100 + rand() % (hz / 10);     // 10ms..110ms
+        qrt::virtual_clock::cycles_type begin  = rand() % period;
+        threads.push_back(new mythread(i, begin, begin + hz * seconds, period));
+        sched0(threads.back());
+    }
+
+    sched0.start();
+    sched0.join();
+
+    for(mythread * t : threads)
+        delete t;
+
+    dispatch = sched0.stat().sched;
+    std::cerr << "virtual time " << qrt::virtual_clock::now() / hz << " s, " << sched0.stat() << std::endl;
+    return digest;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    int nthread = argc > 1 ? atoi(argv[1]) : 10000;
+    int seconds = argc > 2 ? atoi(argv[2]) : 60;
+
+    int d0 = 0, d1 = 0;
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    unsigned long long h0 = replay(nthread, seconds, d0);
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+    unsigned long long h1 = replay(nthread, seconds, d1);
+
+    std::cerr << d0 << " dispatches in " << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() 
+              << " ms (wall), digest " << std::hex << h0 << '/' << h1 << std::dec << std::endl;
+
+    return h0 == h1 && d0 == d1 && d0 > 0 ? 0 : 1;
+}
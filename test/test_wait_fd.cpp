@@ -0,0 +1,202 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <qrt_thread.hpp>
+#include <qrt_group.hpp>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+
+// reader threads suspended on their pipe by qrt_wait_fd, woken through the
+// event source of the scheduler, and a writer thread feeding the pipes. Then
+// the same in a scheduler_group, one event source per scheduler.
+//
+
+static int rounds;
+
+struct reader : public qrt::thread
+{
+    int _M_fd;
+    int _M_n;
+
+public:
+    reader(int fd)
+    : qrt::thread(qrt::this_cpu::get_cycles(), ~qrt::this_cpu::cycles_type()), _M_fd(fd), _M_n()
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(; _M_n < rounds; )
+        {
+            qrt_wait_fd(_M_fd, POLLIN);
+
+            char c;
+            if ((this->revents() & POLLIN) && ::read(_M_fd, &c, 1) == 1)
+                _M_n++;
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+struct writer : public qrt::thread
+{
+    std::vector<int> _M_fd;
+    int _M_round;
+    qrt::this_cpu::cycles_type _M_gap;
+
+public:
+    writer(const std::vector<int> &fd, qrt::this_cpu::cycles_type gap)
+    : qrt::thread(qrt::this_cpu::get_cycles(), ~qrt::this_cpu::cycles_type()), _M_fd(fd), _M_round(), _M_gap(gap)
+    {}
+
+    qrt::this_cpu::cycles_type 
+    run(qrt::this_cpu::cycles_type)
+    {
+        qrt_context_begin;
+
+        for(; _M_round < rounds; ++_M_round)
+        {
+            for(int fd : _M_fd)
+                if (::write(fd, "x", 1) != 1)
+                    std::cerr << "write: " << strerror(errno) << std::endl;
+
+            qrt_sleep_for(_M_gap);
+        }
+
+        qrt_context_end;
+    }    
+};
+
+
+bool
+replay(qrt::event_source &source, const char *name, int npipe)
+{
+    std::vector<int> rd, wr;
+    std::vector<std::unique_ptr<reader> > readers;
+
+    qrt::deadline_scheduler sched0;
+    sched0.wake_source(&source);
+
+    for(int i = 0; i < npipe; ++i)
+    {
+        int p[2];
+        if (::pipe(p) < 0)
+            throw std::runtime_error("pipe");
+        rd.push_back(p[0]); 
+        wr.push_back(p[1]);
+        readers.emplace_back(new reader(p[0]));
+        sched0(readers.back().get());
+    }
+
+    writer w(wr, qrt::tsc_clock::instance().from_us(100));
+    sched0(&w);
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    sched0.start();
+    sched0.join();
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    bool ok = true;
+    for(auto &r : readers)
+        ok = ok && r->_M_n == rounds;
+
+    std::cerr << name << ": " << npipe << " readers x " << rounds << " rounds in " 
+              << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << " ms: " 
+              << (ok ? "ok" : "FAILED") << std::endl;
+
+    for(int fd : rd) ::close(fd);
+    for(int fd : wr) ::close(fd);
+    return ok;
+}
+
+
+bool
+replay_group(int nsched, int npipe)
+{
+    std::vector<int> rd, wr;
+    std::vector<std::unique_ptr<reader> > readers;
+    std::vector<std::unique_ptr<qrt::epoll_source> > sources;
+
+    qrt::deadline_scheduler_group group(std::vector<int>(nsched, 0));
+    for(int i = 0; i < nsched; ++i)
+    {
+        sources.emplace_back(new qrt::epoll_source);
+        group[i].wake_source(sources.back().get());
+    }
+
+    for(int i = 0; i < npipe; ++i)
+    {
+        int p[2];
+        if (::pipe(p) < 0)
+            throw std::runtime_error("pipe");
+        rd.push_back(p[0]); 
+        wr.push_back(p[1]);
+        readers.emplace_back(new reader(p[0]));
+        group(readers.back().get());
+    }
+
+    writer w(wr, qrt::tsc_clock::instance().from_us(100));
+    group(&w);
+
+    group.start();
+    group.join();
+
+    bool ok = true;
+    for(auto &r : readers)
+        ok = ok && r->_M_n == rounds;
+
+    std::cerr << "group of " << nsched << ": " << npipe << " readers x " << rounds << " rounds: " 
+              << (ok ? "ok" : "FAILED") << std::endl;
+
+    for(int fd : rd) ::close(fd);
+    for(int fd : wr) ::close(fd);
+    return ok;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    int npipe = argc > 1 ? atoi(argv[1]) : 1000;
+    rounds    = argc > 2 ? atoi(argv[2]) : 100;
+
+    qrt::epoll_source epoll;
+    bool ok = replay(epoll, "epoll", npipe);
+
+    qrt::uring_source uring(1024);
+    ok = replay(uring, "io_uring", npipe) && ok;
+
+    ok = replay_group(2, std::min(npipe, 64)) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+/* $Id$ */
+/*
+ * qrt::thread++ - LGPL library
+ *
+ * Copyright (C) 2010 Nicola Bonelli
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <qrt_trace.hpp>
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <set>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+// convert scheduling traces (qrt::trace_ring files, one per scheduler) to the
+// Chrome trace event format, loaded by chrome://tracing and ui.perfetto.dev:
+//
+//   qrt_trace2json [-f hz] trace0.bin [trace1.bin ...] > trace.json
+//
+// every scheduler is a process (pid = the sched tag of the ring), every
+// qrt::thread is a thread (tid = its id), the activations are slices.
+
+struct trace_file
+{
+    uint64_t                        hz;
+    int32_t                         sched;
+    std::vector<qrt::trace_event>   events;    /* oldest first */
+};
+
+static trace_file
+load(const char *path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error(std::string("open: ") + path);
+
+    std::vector<char> buf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    if (buf.size() < sizeof(qrt::trace_header))
+        throw std::runtime_error(std::string("short file: ") + path);
+
+    const qrt::trace_header * h = reinterpret_cast<const qrt::trace_header *>(buf.data());
+
+    if (h->magic != qrt::trace_header::magic_value || h->version != 1 ||
+        h->event_size != sizeof(qrt::trace_event))
+        throw std::runtime_error(std::string("not a qrt trace: ") + path);
+
+    trace_file f;
+    f.hz    = h->hz;
+    f.sched = h->sched;
+
+    uint64_t cap  = h->capacity;
+    uint64_t head = h->head.load();
+    if (buf.size() < sizeof(qrt::trace_header) + cap * sizeof(qrt::trace_event))
+        throw std::runtime_error(std::string("truncated trace: ") + path);
+
+    const qrt::trace_event * ev = reinterpret_cast<const qrt::trace_event *>(buf.data() + sizeof(qrt::trace_header));
+
+    // after a crash the slot of the event #head may be half written: once the
+    // ring has wrapped it is the slot of the oldest event, which is skipped...
+
+    for(uint64_t i = head >= cap ? head - cap + 1 : 0; i < head; ++i)
+        f.events.push_back(ev[i & (cap-1)]);
+
+    return f;
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint64_t hz = 0;
+    std::vector<trace_file> traces;
+
+    try {
+        for(int i = 1; i < argc; ++i)
+        {
+            if (std::strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+                hz = std::strtoull(argv[++i], 0, 10);
+                continue;
+            }
+            traces.push_back(load(argv[i]));
+        }
+    }
+    catch(std::exception &e) {
+        std::cerr << "qrt_trace2json: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (traces.empty()) {
+        std::cerr << "usage: qrt_trace2json [-f hz] trace.bin..." << std::endl;
+        return 1;
+    }
+
+    // common time origin...
+
+    uint64_t origin = ~uint64_t();
+    for(auto &f : traces)
+        if (!f.events.empty())
+            origin = std::min(origin, f.events.front().tsc);
+
+    std::cout << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    bool first = true;
+    for(auto &f : traces)
+    {
+        const double rate = static_cast<double>(hz ? hz : f.hz);
+        if (rate == 0) {
+            std::cerr << "qrt_trace2json: unknown TSC rate (use -f hz)" << std::endl;
+            return 1;
+        }
+
+        // cycles to us, relative to the origin...
+        auto us = [&](uint64_t tsc) { return (static_cast<double>(tsc) - static_cast<double>(origin)) * 1e6 / rate; };
+        auto ns = [&](uint64_t cyc) { return static_cast<double>(cyc) * 1e9 / rate; };
+
+        std::set<int32_t> open;
+        char line[256];
+
+        for(auto &e : f.events)
+        {
+            const char * sep = first ? "\n" : ",\n";
+            int n = 0;
+
+            switch(e.type)
+            {
+            case qrt::trace_event::add:
+                n = std::snprintf(line, sizeof(line), "%s{\"name\":\"add\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"deadline_us\":%.3f}}",
+                                  sep, us(e.tsc), f.sched, e.id, us(e.arg));
+                break;
+            case qrt::trace_event::dispatch:
+                open.insert(e.id);
+                n = std::snprintf(line, sizeof(line), "%s{\"name\":\"thread %d\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"deadline_us\":%.3f}}",
+                                  sep, e.id, us(e.tsc), f.sched, e.id, us(e.arg));
+                break;
+            case qrt::trace_event::miss:
+                n = std::snprintf(line, sizeof(line), "%s{\"name\":\"miss\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"lateness_ns\":%.0f}}",
+                                  sep, us(e.tsc), f.sched, e.id, ns(e.arg));
+                break;
+            case qrt::trace_event::wake:
+                n = std::snprintf(line, sizeof(line), "%s{\"name\":\"wake\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"revents\":%u}}",
+                                  sep, us(e.tsc), f.sched, e.id, static_cast<unsigned>(e.arg));
+                break;
+            case qrt::trace_event::ret:
+            case qrt::trace_event::finish:
+                if (!open.erase(e.id))      // its dispatch was overwritten
+                    continue;
+                if (e.type == qrt::trace_event::ret)
+                    n = std::snprintf(line, sizeof(line), "%s{\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"next_deadline_us\":%.3f}}",
+                                      sep, us(e.tsc), f.sched, e.id, us(e.arg));
+                else
+                    n = std::snprintf(line, sizeof(line), "%s{\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"finished\":true}}",
+                                      sep, us(e.tsc), f.sched, e.id);
+                break;
+            default:
+                continue;
+            }
+
+            if (n > 0) {
+                std::cout << line;
+                first = false;
+            }
+        }
+    }
+
+    std::cout << "\n]}" << std::endl;
+    return 0;
+}